@@ -1,18 +1,191 @@
 #include <bits/stdc++.h>
 
+#include <fcntl.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
+using namespace std::chrono_literals;
+
+// live heap bytes, used by the benchmark to report bytes per trie node
+atomic_size_t g_live_bytes{};
+
+constexpr align_val_t malloc_align{alignof(max_align_t)};
+
+// Every global new and delete, nothrow and aligned forms included, goes
+// through these two, so g_live_bytes goes up and down by the same amount
+// for each block. Out of line so that GCC never sees a pointer from
+// operator new reach free(). counted_alloc returns nullptr on failure,
+// only the throwing forms of new turn that into bad_alloc
+[[gnu::noinline]] void *counted_alloc(size_t n, align_val_t align) noexcept {
+  const size_t a{static_cast<size_t>(align)};
+  n = max(n, size_t{1});
+  void *p{a <= alignof(max_align_t) ? malloc(n)
+                                     : aligned_alloc(a, (n + a - 1) / a * a)};
+  if (p) g_live_bytes += malloc_usable_size(p);
+  return p;
+}
+[[gnu::noinline]] void counted_free(void *p) noexcept {
+  if (!p) return;
+  g_live_bytes -= malloc_usable_size(p);
+  free(p);
+}
+
+void *counted_new(size_t n, align_val_t a) {
+  if (void *p = counted_alloc(n, a)) return p;
+  throw bad_alloc{};
+}
+
+void *operator new(size_t n) { return counted_new(n, malloc_align); }
+void *operator new[](size_t n) { return counted_new(n, malloc_align); }
+void *operator new(size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new[](size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new(size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new[](size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new(size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void *operator new[](size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, size_t) noexcept { counted_free(p); }
+void operator delete(void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete[](void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, const nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+
+// tokens of a phrase, e.g. a vector<string> or a vector<const char *>
+template <typename R>
+concept token_range = ranges::input_range<R> &&
+    convertible_to<ranges::range_reference_t<R>, string_view>;
+
+// Fuzzy search compares the text of a path, its tokens joined by spaces,
+// with the text of the query. row[j] is the edit distance between the path
+// text so far and the first j characters of the query, lev_step() updates
+// it for one more character of the path
+void lev_step(vector<size_t> &row, char c, string_view query) {
+  size_t diag{row[0]++};
+  for (size_t j{1}; j < row.size(); ++j) {
+    const size_t up{row[j]};
+    row[j] = min({up + 1, row[j - 1] + 1, diag + (query[j - 1] != c)});
+    diag = up;
+  }
+}
+
+template <typename It>
+string join_tokens(It it, It end_it) {
+  string s{};
+  for (; it != end_it; ++it) {
+    if (!s.empty()) s += ' ';
+    s += *it;
+  }
+  return s;
+}
+
+// paths within the edit limit and their distances, closest first
+using fuzzy_matches = vector<pair<deque<string>, size_t>>;
 
 class Trie {
  public:
-  void insert(const initializer_list<string> &il) {
-    insert_(il.begin(), il.end());
+  // weight is added to the phrase, so repeated inserts count frequency
+  void insert(const initializer_list<string> &il, uint32_t weight = 1) {
+    insert_(il.begin(), il.end(), weight);
   }
 
-  deque<deque<string>> &get() const {
-    result_dq_.clear();
-    deque<string> dq{};
-    get_(dq, result_dq_);
-    return result_dq_;
+  template <token_range R>
+  void insert(const R &tokens, uint32_t weight = 1) {
+    insert_(ranges::begin(tokens), ranges::end(tokens), weight);
+  }
+
+  // Walks the subtree on demand with an explicit stack and yields the tokens
+  // below this node as views. The iterator owns its stack, so any number of
+  // threads may iterate the same (unmodified) trie at once
+  class completion_iterator {
+   public:
+    using value_type = span<const string_view>;
+    using difference_type = ptrdiff_t;
+
+    completion_iterator() = default;
+    explicit completion_iterator(const Trie *t) {
+      frames_.reserve(16);
+      path_.reserve(16);
+      descend_(*t);
+    }
+
+    value_type operator*() const { return path_; }
+    completion_iterator &operator++() {
+      advance_();
+      return *this;
+    }
+    void operator++(int) { advance_(); }
+    bool operator==(default_sentinel_t) const { return done_; }
+
+   private:
+    struct Frame {
+      map<string, Trie>::const_iterator it, end_it;
+    };
+
+    // go down the first children until reaching a leaf
+    void descend_(const Trie &t) {
+      for (const Trie *n{&t}; !n->empty_(); n = &frames_.back().it->second) {
+        frames_.push_back({n->nodes_.begin(), n->nodes_.end()});
+        path_.push_back(frames_.back().it->first);
+      }
+    }
+
+    void advance_() {
+      while (!frames_.empty()) {
+        Frame &f = frames_.back();
+        path_.pop_back();
+        if (++f.it != f.end_it) {
+          path_.push_back(f.it->first);
+          descend_(f.it->second);
+          return;
+        }
+        frames_.pop_back();
+      }
+      done_ = true;
+    }
+
+    vector<Frame> frames_{};
+    vector<string_view> path_{};
+    bool done_{};
+  };
+
+  // e.g. ranges::for_each(t.completions() | views::take(10), ...) only walks
+  // as far as the 10th completion
+  auto completions() const {
+    return ranges::subrange{completion_iterator{this}, default_sentinel};
+  }
+
+  deque<deque<string>> get() const {
+    deque<deque<string>> result_dq{};
+    for (auto path : completions())
+      result_dq.emplace_back(path.begin(), path.end());
+    return result_dq;
   }
 
   deque<string> &find_prefix(const char *s) const {
@@ -30,34 +203,130 @@ class Trie {
     return search_(il.begin(), il.end());
   }
 
+  template <token_range R>
+  optional<const Trie *> search(const R &tokens) const {
+    return search_(ranges::begin(tokens), ranges::end(tokens));
+  }
+
+  // Best-first walk like FlatTrie::Ref::top_k(). Trie nodes have no parent
+  // link, so each opened node keeps a record of its token and its parent's
+  // record, and a phrase's path is rebuilt from those when it comes out
+  vector<pair<deque<string>, uint32_t>> top_k(size_t k) const {
+    struct Record {
+      const Trie *node;
+      const string *token;  // nullptr for this node
+      size_t parent;
+    };
+    vector<Record> records{{this, nullptr, 0}};
+    vector<pair<deque<string>, uint32_t>> result{};
+    // (key, is_phrase, record)
+    priority_queue<tuple<uint32_t, bool, size_t>> pq{};
+    if (max_weight_) pq.emplace(max_weight_, false, 0);
+    while (!pq.empty() && result.size() < k) {
+      const auto [key, is_phrase, r] = pq.top();
+      pq.pop();
+      const Trie &n = *records[r].node;
+      if (is_phrase) {
+        deque<string> path{};
+        for (size_t i{r}; records[i].token; i = records[i].parent)
+          path.push_front(*records[i].token);
+        result.emplace_back(move(path), key);
+        continue;
+      }
+      if (n.weight_) pq.emplace(n.weight_, true, r);
+      for (const auto &[token, child] : n.nodes_) {
+        if (!child.max_weight_) continue;
+        pq.emplace(child.max_weight_, false, records.size());
+        records.push_back({&child, &token, r});
+      }
+    }
+    return result;
+  }
+
+  vector<pair<deque<string>, uint32_t>> top_k(
+      const initializer_list<const char *> &prefix, size_t k) const {
+    if (auto st = search(prefix); st.has_value()) return (*st)->top_k(k);
+    return {};
+  }
+
+  template <token_range R>
+  vector<pair<deque<string>, uint32_t>> top_k(const R &prefix,
+                                              size_t k) const {
+    if (auto st = search(prefix); st.has_value()) return (*st)->top_k(k);
+    return {};
+  }
+
+  // summed weight of the phrases inserted up to exactly this node
+  uint32_t weight() const { return weight_; }
+
+  // Paths whose text is within max_edits of the query text. A DP row is
+  // carried down the walk and a subtree is skipped as soon as no entry of
+  // the row is within the limit, because appending text never lowers it
+  fuzzy_matches search_within(const initializer_list<const char *> &il,
+                              size_t max_edits) const {
+    return search_within_(join_tokens(il.begin(), il.end()), max_edits);
+  }
+
+  template <token_range R>
+  fuzzy_matches search_within(const R &tokens, size_t max_edits) const {
+    return search_within_(
+        join_tokens(ranges::begin(tokens), ranges::end(tokens)), max_edits);
+  }
+
  private:
+  fuzzy_matches search_within_(const string &query, size_t max_edits) const {
+    vector<size_t> row(query.size() + 1);
+    iota(row.begin(), row.end(), 0);
+    deque<string> dq{};
+    fuzzy_matches result{};
+    search_within_(query, max_edits, row, dq, result);
+    ranges::stable_sort(result, {}, &fuzzy_matches::value_type::second);
+    return result;
+  }
+
+  void search_within_(const string &query, size_t max_edits,
+                      const vector<size_t> &row, deque<string> &dq,
+                      fuzzy_matches &result) const {
+    for (const auto &[k, v] : nodes_) {
+      vector<size_t> next{row};
+      if (!dq.empty()) lev_step(next, ' ', query);
+      bool pruned{};
+      for (char c : k) {
+        lev_step(next, c, query);
+        if ((pruned = ranges::min(next) > max_edits)) break;
+      }
+      if (pruned) continue;
+      dq.push_back(k);
+      if (next.back() <= max_edits) result.emplace_back(dq, next.back());
+      v.search_within_(query, max_edits, next, dq, result);
+      dq.pop_back();
+    }
+  }
+
   // e.g. {"a", "b, "c"}
   // after the recursive call, the trie will look like:
   // {"a": {"b": {"c": {}}}}
+  // Returns the new weight of the phrase, weights only grow so every node
+  // on the way back keeps an exact max_weight_
   template <typename It>
-  void insert_(It it, It end_it) {
-    if (it == end_it) return;
-    nodes_[*it].insert_(++it, end_it);
-  }
-
-  void get_(deque<string> &dq, deque<deque<string>> &result_dq) const {
-    if (empty_()) {
-      result_dq.push_back(dq);
-      dq.clear();
-    }
-    for (const auto &p : nodes_) {
-      dq.push_back(p.first);
-      p.second.get_(dq, result_dq);
+  uint32_t insert_(It it, It end_it, uint32_t weight) {
+    if (it == end_it) {
+      weight_ += weight;
+      max_weight_ = max(max_weight_, weight_);
+      return weight_;
     }
+    Trie &child = nodes_[*it];
+    const uint32_t w{child.insert_(++it, end_it, weight)};
+    max_weight_ = max(max_weight_, w);
+    return w;
   }
 
+  // keys starting with s form one run of the sorted map
   void find_prefix_(const string &s, auto &pre_dq) const {
-    if (empty_()) return;
-    for (const auto &[k, v] : nodes_) {
-      if (k.starts_with(s)) {
-        pre_dq.emplace_back(k);
-        v.find_prefix_(k, pre_dq);
-      }
+    for (auto it = nodes_.lower_bound(s);
+         it != nodes_.end() && it->first.starts_with(s); ++it) {
+      pre_dq.emplace_back(it->first);
+      it->second.find_prefix_(it->first, pre_dq);
     }
   }
 
@@ -71,13 +340,1130 @@ class Trie {
 
   bool empty_() const { return nodes_.empty(); }
 
-  mutable deque<deque<string>> result_dq_{};
   mutable deque<string> prefix_dq_{};
   map<string, Trie> nodes_{};
+  // weight of the phrase ending here (0: none) and the largest weight in
+  // the subtree, which lets top_k() skip subtrees
+  uint32_t weight_{};
+  uint32_t max_weight_{};
+};
+
+// Interns every distinct token once. Tokens are referred to by a dense id and
+// their bytes live in fixed-size blocks, so views into them stay valid
+class TokenPool {
+ public:
+  uint32_t intern(string_view s) {
+    if (auto it = ids_.find(s); it != ids_.end()) return it->second;
+    const auto id = static_cast<uint32_t>(tokens_.size());
+    tokens_.push_back(store_(s));
+    ids_.emplace(tokens_.back(), id);
+    return id;
+  }
+
+  optional<uint32_t> find(string_view s) const {
+    if (auto it = ids_.find(s); it != ids_.end()) return it->second;
+    return {};
+  }
+
+  string_view operator[](uint32_t id) const { return tokens_[id]; }
+  size_t size() const { return tokens_.size(); }
+
+ private:
+  static constexpr size_t block_size_{64 * 1024};
+
+  string_view store_(string_view s) {
+    if (blocks_.empty() || block_used_ + s.size() > block_cap_) {
+      block_cap_ = max(block_size_, s.size());
+      blocks_.emplace_back(make_unique_for_overwrite<char[]>(block_cap_));
+      block_used_ = 0;
+    }
+    char *p = blocks_.back().get() + block_used_;
+    ranges::copy(s, p);
+    block_used_ += s.size();
+    return {p, s.size()};
+  }
+
+  vector<unique_ptr<char[]>> blocks_{};
+  size_t block_used_{};
+  size_t block_cap_{};
+  vector<string_view> tokens_{};
+  unordered_map<string_view, uint32_t> ids_{};
+};
+
+// Same interface as Trie, but all nodes live in one arena vector and refer to
+// each other by index. Children are chained through next_sibling for
+// traversal and found through a flat (parent, token) -> child hash table
+class FlatTrie {
+ public:
+  using node_id = uint32_t;
+  static constexpr node_id npos{numeric_limits<node_id>::max()};
+
+  // Same walk as Trie::completion_iterator. Children are kept unordered in
+  // the arena, so each level is sorted into a scratch buffer owned by the
+  // iterator; after the first few levels the walk no longer allocates
+  class completion_iterator {
+   public:
+    using value_type = span<const string_view>;
+    using difference_type = ptrdiff_t;
+
+    completion_iterator() = default;
+    completion_iterator(const FlatTrie *trie, node_id id) : trie_{trie} {
+      frames_.reserve(16);
+      path_.reserve(16);
+      children_.reserve(64);
+      descend_(id);
+    }
+
+    value_type operator*() const { return path_; }
+    completion_iterator &operator++() {
+      advance_();
+      return *this;
+    }
+    void operator++(int) { advance_(); }
+    bool operator==(default_sentinel_t) const { return done_; }
+
+   private:
+    // [pos, end) of the sorted siblings in children_
+    struct Frame {
+      size_t pos, end;
+    };
+
+    void descend_(node_id id) {
+      while (trie_->nodes_[id].first_child != npos) {
+        const size_t begin{children_.size()};
+        trie_->append_sorted_children_(id, children_);
+        frames_.push_back({begin, children_.size()});
+        id = children_[begin];
+        path_.push_back(trie_->token_(id));
+      }
+    }
+
+    void advance_() {
+      while (!frames_.empty()) {
+        Frame &f = frames_.back();
+        path_.pop_back();
+        if (++f.pos != f.end) {
+          path_.push_back(trie_->token_(children_[f.pos]));
+          descend_(children_[f.pos]);
+          return;
+        }
+        frames_.pop_back();
+        children_.resize(frames_.empty() ? 0 : frames_.back().end);
+      }
+      done_ = true;
+    }
+
+    const FlatTrie *trie_{};
+    vector<Frame> frames_{};
+    vector<string_view> path_{};
+    vector<node_id> children_{};
+    bool done_{};
+  };
+
+  // Handle to a subtrie, plays the role of the const Trie * returned by
+  // Trie::search(). Valid as long as the trie is not modified
+  class Ref {
+   public:
+    Ref(const FlatTrie *trie, node_id id) : trie_{trie}, id_{id} {}
+
+    auto completions() const {
+      return ranges::subrange{completion_iterator{trie_, id_},
+                              default_sentinel};
+    }
+
+    deque<deque<string>> get() const {
+      deque<deque<string>> result_dq{};
+      for (auto path : completions())
+        result_dq.emplace_back(path.begin(), path.end());
+      return result_dq;
+    }
+
+    deque<string> find_prefix(const char *s) const {
+      deque<string> prefix_dq{};
+      trie_->find_prefix_(id_, s, prefix_dq);
+      return prefix_dq;
+    }
+
+    optional<Ref> search(const initializer_list<const char *> &il) const {
+      return trie_->search_(id_, il.begin(), il.end());
+    }
+
+    optional<Ref> search(const string &s) const {
+      const initializer_list<const char *> il{s.c_str()};
+      return search(il);
+    }
+
+    template <token_range R>
+    optional<Ref> search(const R &tokens) const {
+      return trie_->search_(id_, ranges::begin(tokens), ranges::end(tokens));
+    }
+
+    // Best-first walk over the subtree: a queue entry is either a whole
+    // subtree keyed by its cached max_weight or a phrase keyed by its own
+    // weight, so only subtrees that can still beat the k-th result are
+    // opened. Phrases come out by decreasing weight
+    vector<pair<deque<string>, uint32_t>> top_k(size_t k) const {
+      const auto &nodes = trie_->nodes_;
+      vector<pair<deque<string>, uint32_t>> result{};
+      // (key, is_phrase, node)
+      priority_queue<tuple<uint32_t, bool, node_id>> pq{};
+      if (nodes[id_].max_weight) pq.emplace(nodes[id_].max_weight, false, id_);
+      while (!pq.empty() && result.size() < k) {
+        const auto [key, is_phrase, id] = pq.top();
+        pq.pop();
+        if (is_phrase) {
+          result.emplace_back(trie_->path_(id_, id), key);
+          continue;
+        }
+        if (nodes[id].weight) pq.emplace(nodes[id].weight, true, id);
+        for (node_id c{nodes[id].first_child}; c != npos;
+             c = nodes[c].next_sibling)
+          if (nodes[c].max_weight) pq.emplace(nodes[c].max_weight, false, c);
+      }
+      return result;
+    }
+
+    // same as Trie::search_within, for the paths below this node
+    fuzzy_matches search_within(const initializer_list<const char *> &il,
+                                size_t max_edits) const {
+      return trie_->search_within_(id_, join_tokens(il.begin(), il.end()),
+                                   max_edits);
+    }
+
+    template <token_range R>
+    fuzzy_matches search_within(const R &tokens, size_t max_edits) const {
+      return trie_->search_within_(
+          id_, join_tokens(ranges::begin(tokens), ranges::end(tokens)),
+          max_edits);
+    }
+
+    // summed weight of the phrases inserted up to exactly this node
+    uint32_t weight() const { return trie_->nodes_[id_].weight; }
+
+    node_id id() const { return id_; }
+
+    // pointer-like access, so that *trie.search(...).value() reads the same
+    // for Trie and FlatTrie
+    const Ref &operator*() const { return *this; }
+    const Ref *operator->() const { return this; }
+
+   private:
+    const FlatTrie *trie_;
+    node_id id_;
+  };
+
+  FlatTrie() : nodes_(1), edges_(min_edges_) {}
+
+  // weight is added to the phrase, so repeated inserts count frequency
+  void insert(const initializer_list<string> &il, uint32_t weight = 1) {
+    insert_(il.begin(), il.end(), weight);
+  }
+
+  template <token_range R>
+  void insert(const R &tokens, uint32_t weight = 1) {
+    insert_(ranges::begin(tokens), ranges::end(tokens), weight);
+  }
+
+  auto completions() const { return root().completions(); }
+
+  vector<pair<deque<string>, uint32_t>> top_k(
+      const initializer_list<const char *> &prefix, size_t k) const {
+    if (auto st = search(prefix); st.has_value()) return st->top_k(k);
+    return {};
+  }
+
+  template <token_range R>
+  vector<pair<deque<string>, uint32_t>> top_k(const R &prefix,
+                                              size_t k) const {
+    if (auto st = search(prefix); st.has_value()) return st->top_k(k);
+    return {};
+  }
+
+  fuzzy_matches search_within(const initializer_list<const char *> &il,
+                              size_t max_edits) const {
+    return root().search_within(il, max_edits);
+  }
+
+  template <token_range R>
+  fuzzy_matches search_within(const R &tokens, size_t max_edits) const {
+    return root().search_within(tokens, max_edits);
+  }
+
+  deque<deque<string>> get() const { return root().get(); }
+
+  deque<string> find_prefix(const char *s) const {
+    return root().find_prefix(s);
+  }
+
+  optional<Ref> search(const initializer_list<const char *> &il) const {
+    return root().search(il);
+  }
+
+  optional<Ref> search(const string &s) const { return root().search(s); }
+
+  template <token_range R>
+  optional<Ref> search(const R &tokens) const {
+    return root().search(tokens);
+  }
+
+  // Looks up many token sequences at once, results are in input order. The
+  // batch is cut into one run of search() calls per thread. Sorting a run so
+  // that shared prefixes are walked once was measured slower than the
+  // lookups it saves, since each token still has to be found by its string
+  vector<optional<Ref>> search_batch(span<const vector<string>> queries,
+                                     size_t threads = 1) const {
+    vector<optional<Ref>> result(queries.size());
+    auto run = [&](size_t begin, size_t end) {
+      for (size_t i{begin}; i < end; ++i) result[i] = search(queries[i]);
+    };
+    if (threads <= 1) {
+      run(0, queries.size());
+    } else {
+      vector<jthread> runs{};
+      const size_t chunk{(queries.size() + threads - 1) / threads};
+      for (size_t i{}; i < queries.size(); i += chunk)
+        runs.emplace_back(run, i, min(i + chunk, queries.size()));
+    }
+    return result;
+  }
+
+  Ref root() const { return {this, 0}; }
+
+  // number of nodes, not counting the root
+  size_t size() const { return nodes_.size() - 1; }
+
+  // Builds a trie from lexicographically sorted phrases in one linear pass:
+  // each phrase only adds the tokens after the part it shares with the
+  // previous one, so nothing is looked up. Runs of phrases with the same
+  // first token are independent subtrees and are built on separate threads,
+  // then moved into one arena. phrases must be sorted, unsorted input builds
+  // a wrong trie. Empty phrases sort first and mark the root like insert({})
+  static FlatTrie build_sorted(span<const vector<string>> phrases,
+                               size_t threads = 1) {
+    assert(ranges::is_sorted(phrases));
+    FlatTrie t;
+    if (threads <= 1 || phrases.size() < 2 * threads) {
+      t.append_sorted_(phrases);
+      t.finish_sorted_();
+      return t;
+    }
+    // cut at first-token boundaries near every size / threads phrases, the
+    // empty phrases all come before the first cut
+    const auto same_first = [&](size_t c) {
+      return !phrases[c].empty() && !phrases[c - 1].empty() &&
+             phrases[c][0] == phrases[c - 1][0];
+    };
+    vector<size_t> cuts{0};
+    for (size_t i{1}; i < threads; ++i) {
+      size_t c{max(cuts.back(), phrases.size() * i / threads)};
+      while (c < phrases.size() && c > 0 && same_first(c)) ++c;
+      if (c != cuts.back() && c != phrases.size()) cuts.push_back(c);
+    }
+    cuts.push_back(phrases.size());
+    vector<FlatTrie> parts(cuts.size() - 1);
+    {
+      vector<jthread> builders{};
+      for (size_t i{}; i < parts.size(); ++i) {
+        builders.emplace_back([&, i] {
+          parts[i].append_sorted_(
+              phrases.subspan(cuts[i], cuts[i + 1] - cuts[i]));
+          parts[i].update_max_weights_();
+        });
+      }
+    }
+    for (const auto &part : parts) t.merge_(part);
+    t.build_edges_();
+    t.build_wide_index_();
+    return t;
+  }
+
+ private:
+  static constexpr size_t min_edges_{16};
+  // nodes with more children than this keep an index of sorted runs
+  static constexpr uint32_t max_narrow_{16};
+
+  struct Node {
+    uint32_t token{};
+    node_id parent{npos};
+    node_id first_child{npos};
+    node_id next_sibling{npos};
+    // weight of the phrase ending here (0: none) and the largest weight in
+    // the subtree, which bounds every phrase below this node
+    uint32_t weight{};
+    uint32_t max_weight{};
+    uint32_t child_count{};
+  };
+
+  struct Edge {
+    node_id parent{npos};
+    uint32_t token{};
+    node_id child{npos};
+  };
+
+  template <typename It>
+  void insert_(It it, It end_it, uint32_t weight) {
+    node_id cur{};
+    for (; it != end_it; ++it) {
+      const uint32_t token = tokens_.intern(*it);
+      node_id next = child_(cur, token);
+      if (next == npos) {
+        next = static_cast<node_id>(nodes_.size());
+        nodes_.push_back({token, cur, npos, nodes_[cur].first_child});
+        nodes_[cur].first_child = next;
+        ++nodes_[cur].child_count;
+        add_edge_(cur, token, next);
+        add_child_index_(cur, next);
+      }
+      cur = next;
+    }
+    // weights only grow, so the cached maxima stay exact
+    const uint32_t w{nodes_[cur].weight += weight};
+    for (; cur != npos && nodes_[cur].max_weight < w; cur = nodes_[cur].parent)
+      nodes_[cur].max_weight = w;
+  }
+
+  // appends below the root, only valid on an empty trie and without edges
+  void append_sorted_(span<const vector<string>> phrases) {
+    vector<node_id> path{0};
+    const vector<string> *prev{};
+    for (const auto &p : phrases) {
+      size_t common{};
+      if (prev)
+        while (common < min(p.size(), prev->size()) &&
+               p[common] == (*prev)[common])
+          ++common;
+      path.resize(common + 1);
+      for (size_t d{common}; d < p.size(); ++d) {
+        const node_id parent{path.back()};
+        const auto id = static_cast<node_id>(nodes_.size());
+        nodes_.push_back({tokens_.intern(p[d]), parent, npos,
+                          nodes_[parent].first_child});
+        nodes_[parent].first_child = id;
+        ++nodes_[parent].child_count;
+        path.push_back(id);
+      }
+      ++nodes_[path.back()].weight;
+      prev = &p;
+    }
+  }
+
+  void finish_sorted_() {
+    update_max_weights_();
+    build_edges_();
+    build_wide_index_();
+  }
+
+  // children always come after their parent in the arena
+  void update_max_weights_() {
+    for (auto id = static_cast<node_id>(nodes_.size()); id-- > 0;) {
+      Node &n = nodes_[id];
+      n.max_weight = max(n.max_weight, n.weight);
+      if (n.parent != npos)
+        nodes_[n.parent].max_weight =
+            max(nodes_[n.parent].max_weight, n.max_weight);
+    }
+  }
+
+  // appends the nodes of part, which shares no first token with this trie
+  void merge_(const FlatTrie &part) {
+    vector<uint32_t> token_map(part.tokens_.size());
+    for (uint32_t i{}; i < token_map.size(); ++i)
+      token_map[i] = tokens_.intern(part.tokens_[i]);
+    // part's root becomes our root, every other node moves up by base
+    const auto base = static_cast<node_id>(nodes_.size() - 1);
+    auto map_id = [base](node_id id) {
+      return id == 0 || id == npos ? id : id + base;
+    };
+    for (size_t i{1}; i < part.nodes_.size(); ++i) {
+      const Node &n = part.nodes_[i];
+      nodes_.push_back({token_map[n.token], map_id(n.parent),
+                        map_id(n.first_child), map_id(n.next_sibling),
+                        n.weight, n.max_weight, n.child_count});
+    }
+    // a part of only empty phrases has no children but still weighs the root
+    nodes_[0].weight += part.nodes_[0].weight;
+    nodes_[0].max_weight = max(nodes_[0].max_weight, part.nodes_[0].max_weight);
+    // link the old first children of the root after the new ones
+    node_id last{map_id(part.nodes_[0].first_child)};
+    if (last == npos) return;
+    while (nodes_[last].next_sibling != npos) last = nodes_[last].next_sibling;
+    nodes_[last].next_sibling = nodes_[0].first_child;
+    nodes_[0].first_child = map_id(part.nodes_[0].first_child);
+    nodes_[0].child_count += part.nodes_[0].child_count;
+  }
+
+  void build_edges_() {
+    edges_.assign(bit_ceil(max(min_edges_, 2 * nodes_.size())), Edge{});
+    num_edges_ = 0;
+    for (size_t i{1}; i < nodes_.size(); ++i)
+      add_edge_(nodes_[i].parent, nodes_[i].token, static_cast<node_id>(i));
+  }
+
+  fuzzy_matches search_within_(node_id id, const string &query,
+                               size_t max_edits) const {
+    vector<size_t> row(query.size() + 1);
+    iota(row.begin(), row.end(), 0);
+    deque<string> dq{};
+    fuzzy_matches result{};
+    search_within_(id, query, max_edits, row, dq, result);
+    ranges::stable_sort(result, {}, &fuzzy_matches::value_type::second);
+    return result;
+  }
+
+  void search_within_(node_id id, const string &query, size_t max_edits,
+                      const vector<size_t> &row, deque<string> &dq,
+                      fuzzy_matches &result) const {
+    vector<node_id> children{};
+    append_sorted_children_(id, children);
+    vector<size_t> next{};
+    for (node_id c : children) {
+      next = row;
+      if (!dq.empty()) lev_step(next, ' ', query);
+      bool pruned{};
+      for (char ch : token_(c)) {
+        lev_step(next, ch, query);
+        if ((pruned = ranges::min(next) > max_edits)) break;
+      }
+      if (pruned) continue;
+      dq.emplace_back(token_(c));
+      if (next.back() <= max_edits) result.emplace_back(dq, next.back());
+      search_within_(c, query, max_edits, next, dq, result);
+      dq.pop_back();
+    }
+  }
+
+  // tokens from below ancestor down to id
+  deque<string> path_(node_id ancestor, node_id id) const {
+    deque<string> dq{};
+    for (; id != ancestor; id = nodes_[id].parent) dq.emplace_front(token_(id));
+    return dq;
+  }
+
+  template <typename It>
+  optional<Ref> search_(node_id cur, It it, It end_it) const {
+    for (; it != end_it; ++it) {
+      auto token = tokens_.find(*it);
+      if (!token) return {};
+      if ((cur = child_(cur, *token)) == npos) return {};
+    }
+    return Ref{this, cur};
+  }
+
+  // In each sorted run of a wide node the children starting with s follow
+  // lower_bound(s). Narrow nodes are scanned
+  void find_prefix_(node_id id, string_view s, deque<string> &pre_dq) const {
+    auto by_token = [this](node_id c) { return token_(c); };
+    vector<node_id> matches{};
+    if (auto w = wide_.find(id); w != wide_.end()) {
+      for (const auto &run : w->second)
+        for (auto it = ranges::lower_bound(run, s, {}, by_token);
+             it != run.end() && token_(*it).starts_with(s); ++it)
+          matches.push_back(*it);
+    } else {
+      for (node_id c{nodes_[id].first_child}; c != npos;
+           c = nodes_[c].next_sibling)
+        if (token_(c).starts_with(s)) matches.push_back(c);
+    }
+    ranges::sort(matches, {}, by_token);
+    for (node_id c : matches) {
+      pre_dq.emplace_back(token_(c));
+      find_prefix_(c, token_(c), pre_dq);
+    }
+  }
+
+  // children in token order, the order map<string, Trie> keeps them in
+  void append_sorted_children_(node_id id, vector<node_id> &out) const {
+    auto less = [this](node_id a, node_id b) { return token_(a) < token_(b); };
+    const size_t begin{out.size()};
+    if (auto w = wide_.find(id); w != wide_.end()) {
+      for (const auto &run : w->second) {
+        const size_t mid{out.size()};
+        out.insert(out.end(), run.begin(), run.end());
+        inplace_merge(out.begin() + begin, out.begin() + mid, out.end(), less);
+      }
+      return;
+    }
+    for (node_id c{nodes_[id].first_child}; c != npos;
+         c = nodes_[c].next_sibling)
+      out.push_back(c);
+    sort(out.begin() + begin, out.end(), less);
+  }
+
+  // Keeps the child index of parent up to date after adding child. The new
+  // child becomes a run of its own and the last two runs are merged while
+  // the newer one is at least as long, like carries in a binary counter.
+  // Each child is then merged O(log n) times, where keeping one sorted
+  // vector would move every sibling on every insert
+  void add_child_index_(node_id parent, node_id child) {
+    if (nodes_[parent].child_count <= max_narrow_) return;
+    auto w = wide_.find(parent);
+    if (w == wide_.end()) {
+      vector<node_id> children{};
+      append_sorted_children_(parent, children);
+      wide_[parent].push_back(move(children));
+      return;
+    }
+    auto by_token = [this](node_id c) { return token_(c); };
+    auto &runs = w->second;
+    runs.push_back({child});
+    while (runs.size() > 1 && runs.end()[-2].size() <= runs.back().size()) {
+      vector<node_id> merged(runs.end()[-2].size() + runs.back().size());
+      ranges::merge(runs.end()[-2], runs.back(), merged.begin(), {}, by_token,
+                    by_token);
+      runs.pop_back();
+      runs.back() = move(merged);
+    }
+  }
+
+  void build_wide_index_() {
+    wide_.clear();
+    for (node_id id{}; id < nodes_.size(); ++id) {
+      if (nodes_[id].child_count <= max_narrow_) continue;
+      vector<node_id> children{};
+      append_sorted_children_(id, children);
+      wide_[id].push_back(move(children));
+    }
+  }
+
+  string_view token_(node_id id) const { return tokens_[nodes_[id].token]; }
+
+  static size_t hash_(node_id parent, uint32_t token) {
+    uint64_t h{(uint64_t{parent} << 32 | token) * 0x9E3779B97F4A7C15ull};
+    return h ^ (h >> 29);
+  }
+
+  node_id child_(node_id parent, uint32_t token) const {
+    const size_t mask{edges_.size() - 1};
+    for (size_t i{hash_(parent, token) & mask};; i = (i + 1) & mask) {
+      const Edge &e = edges_[i];
+      if (e.child == npos) return npos;
+      if (e.parent == parent && e.token == token) return e.child;
+    }
+  }
+
+  // open addressing with linear probing, kept at most half full
+  void add_edge_(node_id parent, uint32_t token, node_id child) {
+    if (2 * (num_edges_ + 1) > edges_.size()) {
+      vector<Edge> old(edges_.size() * 2);
+      swap(old, edges_);
+      num_edges_ = 0;
+      for (const Edge &e : old)
+        if (e.child != npos) add_edge_(e.parent, e.token, e.child);
+    }
+    const size_t mask{edges_.size() - 1};
+    size_t i{hash_(parent, token) & mask};
+    while (edges_[i].child != npos) i = (i + 1) & mask;
+    edges_[i] = {parent, token, child};
+    ++num_edges_;
+  }
+
+  friend class MappedTrie;
+
+  vector<Node> nodes_;
+  vector<Edge> edges_;
+  size_t num_edges_{};
+  // sorted runs of the children of each wide node, longest first
+  unordered_map<node_id, vector<vector<node_id>>> wide_{};
+  TokenPool tokens_{};
+};
+
+// Read-only trie over a position independent image written from a FlatTrie:
+//   Header | Node[node_count] | token bytes
+// Nodes are stored breadth first, so the children of a node are contiguous
+// and sorted by token, and every reference is an index or an offset. The
+// image is mapped rather than read, so opening costs O(1) and the pages are
+// shared by every process that maps the same file
+class MappedTrie {
+ public:
+  using node_id = uint32_t;
+
+  struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_count;
+    uint64_t token_bytes;
+  };
+
+  struct Node {
+    uint32_t token_off;
+    uint32_t token_len;
+    node_id first_child;
+    uint32_t child_count;
+  };
+
+  static constexpr char magic[8]{'T', 'R', 'I', 'E', 'I', 'M', 'G', '\0'};
+  static constexpr uint32_t version{1};
+
+  class completion_iterator {
+   public:
+    using value_type = span<const string_view>;
+    using difference_type = ptrdiff_t;
+
+    completion_iterator() = default;
+    completion_iterator(const MappedTrie *trie, node_id id) : trie_{trie} {
+      frames_.reserve(16);
+      path_.reserve(16);
+      descend_(id);
+    }
+
+    value_type operator*() const { return path_; }
+    completion_iterator &operator++() {
+      advance_();
+      return *this;
+    }
+    void operator++(int) { advance_(); }
+    bool operator==(default_sentinel_t) const { return done_; }
+
+   private:
+    struct Frame {
+      node_id pos, end;
+    };
+
+    void descend_(node_id id) {
+      for (const Node *n{&trie_->nodes_[id]}; n->child_count;
+           n = &trie_->nodes_[n->first_child]) {
+        frames_.push_back({n->first_child, n->first_child + n->child_count});
+        path_.push_back(trie_->token_(n->first_child));
+      }
+    }
+
+    void advance_() {
+      while (!frames_.empty()) {
+        Frame &f = frames_.back();
+        path_.pop_back();
+        if (++f.pos != f.end) {
+          path_.push_back(trie_->token_(f.pos));
+          descend_(f.pos);
+          return;
+        }
+        frames_.pop_back();
+      }
+      done_ = true;
+    }
+
+    const MappedTrie *trie_{};
+    vector<Frame> frames_{};
+    vector<string_view> path_{};
+    bool done_{};
+  };
+
+  class Ref {
+   public:
+    Ref(const MappedTrie *trie, node_id id) : trie_{trie}, id_{id} {}
+
+    auto completions() const {
+      return ranges::subrange{completion_iterator{trie_, id_},
+                              default_sentinel};
+    }
+
+    deque<deque<string>> get() const {
+      deque<deque<string>> result_dq{};
+      for (auto path : completions())
+        result_dq.emplace_back(path.begin(), path.end());
+      return result_dq;
+    }
+
+    deque<string> find_prefix(const char *s) const {
+      deque<string> prefix_dq{};
+      trie_->find_prefix_(id_, s, prefix_dq);
+      return prefix_dq;
+    }
+
+    optional<Ref> search(const initializer_list<const char *> &il) const {
+      return trie_->search_(id_, il.begin(), il.end());
+    }
+
+    optional<Ref> search(const string &s) const {
+      const initializer_list<const char *> il{s.c_str()};
+      return search(il);
+    }
+
+    template <token_range R>
+    optional<Ref> search(const R &tokens) const {
+      return trie_->search_(id_, ranges::begin(tokens), ranges::end(tokens));
+    }
+
+    node_id id() const { return id_; }
+
+    const Ref &operator*() const { return *this; }
+    const Ref *operator->() const { return this; }
+
+   private:
+    const MappedTrie *trie_;
+    node_id id_;
+  };
+
+  // returns false if the file cannot be written or the tokens do not fit the
+  // 32-bit offsets of the format
+  static bool write(const FlatTrie &t, const filesystem::path &path) {
+    vector<Node> nodes{{}};
+    string token_bytes{};
+    // offset of each FlatTrie token in token_bytes, written once
+    vector<uint32_t> token_off(t.tokens_.size(), 0xFFFFFFFF);
+    vector<FlatTrie::node_id> order{0}, children{};
+    for (size_t i{}; i < order.size(); ++i) {
+      children.clear();
+      t.append_sorted_children_(order[i], children);
+      nodes[i].first_child = static_cast<node_id>(nodes.size());
+      nodes[i].child_count = static_cast<uint32_t>(children.size());
+      for (FlatTrie::node_id c : children) {
+        const uint32_t token{t.nodes_[c].token};
+        const string_view s{t.tokens_[token]};
+        if (token_off[token] == 0xFFFFFFFF) {
+          if (token_bytes.size() + s.size() > numeric_limits<uint32_t>::max())
+            return false;
+          token_off[token] = static_cast<uint32_t>(token_bytes.size());
+          token_bytes += s;
+        }
+        nodes.push_back({token_off[token], static_cast<uint32_t>(s.size()),
+                         0, 0});
+        order.push_back(c);
+      }
+    }
+
+    Header h{};
+    ranges::copy(magic, h.magic);
+    h.version = version;
+    h.node_count = static_cast<uint32_t>(nodes.size());
+    h.token_bytes = token_bytes.size();
+    ofstream out{path, ios::binary | ios::trunc};
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char *>(nodes.data()),
+              nodes.size() * sizeof(Node));
+    out.write(token_bytes.data(), token_bytes.size());
+    return out.good();
+  }
+
+  // Maps the image read-only, nullopt if it is missing or malformed. Every
+  // node is checked once here so that lookups never leave the mapping
+  static optional<MappedTrie> open(const filesystem::path &path) {
+    const int fd{::open(path.c_str(), O_RDONLY)};
+    if (fd < 0) return {};
+    struct stat st {};
+    void *base{MAP_FAILED};
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header))
+      base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file referenced
+    ::close(fd);
+    if (base == MAP_FAILED) return {};
+
+    MappedTrie mt{base, size_t(st.st_size)};
+    const Header &h = *mt.header_();
+    // bounded one term at a time so that the sum cannot wrap around
+    if (!ranges::equal(h.magic, magic) || h.version != version ||
+        h.node_count == 0 || h.token_bytes > mt.size_ - sizeof(Header) ||
+        h.node_count >
+            (mt.size_ - sizeof(Header) - h.token_bytes) / sizeof(Node) ||
+        sizeof(Header) + h.node_count * sizeof(Node) + h.token_bytes !=
+            mt.size_)
+      return {};
+    mt.nodes_ = reinterpret_cast<const Node *>(mt.base_ + sizeof(Header));
+    mt.tokens_ = reinterpret_cast<const char *>(mt.nodes_ + h.node_count);
+    if (!mt.valid_()) return {};
+    return mt;
+  }
+
+  MappedTrie(MappedTrie &&o) noexcept
+      : base_{exchange(o.base_, nullptr)},
+        size_{o.size_},
+        nodes_{o.nodes_},
+        tokens_{o.tokens_} {}
+  MappedTrie &operator=(MappedTrie &&o) noexcept {
+    swap(base_, o.base_);
+    swap(size_, o.size_);
+    swap(nodes_, o.nodes_);
+    swap(tokens_, o.tokens_);
+    return *this;
+  }
+  ~MappedTrie() {
+    if (base_) munmap(const_cast<byte *>(base_), size_);
+  }
+
+  auto completions() const { return root().completions(); }
+
+  deque<deque<string>> get() const { return root().get(); }
+
+  deque<string> find_prefix(const char *s) const {
+    return root().find_prefix(s);
+  }
+
+  optional<Ref> search(const initializer_list<const char *> &il) const {
+    return root().search(il);
+  }
+
+  optional<Ref> search(const string &s) const { return root().search(s); }
+
+  template <token_range R>
+  optional<Ref> search(const R &tokens) const {
+    return root().search(tokens);
+  }
+
+  Ref root() const { return {this, 0}; }
+
+  size_t size() const { return header_()->node_count - 1; }
+
+ private:
+  MappedTrie(const void *base, size_t size)
+      : base_{static_cast<const byte *>(base)}, size_{size} {}
+
+  const Header *header_() const {
+    return reinterpret_cast<const Header *>(base_);
+  }
+
+  string_view token_(node_id id) const {
+    return {tokens_ + nodes_[id].token_off, nodes_[id].token_len};
+  }
+
+  // The root is node 0 and node_count is at least 1. Tokens must lie in the
+  // token bytes and children in the node array, after their parent as in
+  // breadth-first order, so that no walk can loop
+  bool valid_() const {
+    const Header &h = *header_();
+    for (uint64_t i{}; i < h.node_count; ++i) {
+      const Node &n = nodes_[i];
+      if (uint64_t{n.token_off} + n.token_len > h.token_bytes) return false;
+      if (n.child_count && (n.first_child <= i ||
+                            uint64_t{n.first_child} + n.child_count >
+                                h.node_count))
+        return false;
+    }
+    return true;
+  }
+
+  // children of id whose token is not less than s
+  node_id lower_bound_(node_id id, string_view s) const {
+    node_id first{nodes_[id].first_child};
+    node_id count{nodes_[id].child_count};
+    while (count) {
+      const node_id half{count / 2};
+      if (token_(first + half) < s) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return first;
+  }
+
+  template <typename It>
+  optional<Ref> search_(node_id cur, It it, It end_it) const {
+    for (; it != end_it; ++it) {
+      const string_view s{*it};
+      const node_id c{lower_bound_(cur, s)};
+      if (c == nodes_[cur].first_child + nodes_[cur].child_count ||
+          token_(c) != s)
+        return {};
+      cur = c;
+    }
+    return Ref{this, cur};
+  }
+
+  // the matching children form one contiguous run starting at lower_bound_
+  void find_prefix_(node_id id, string_view s, deque<string> &pre_dq) const {
+    const node_id end{nodes_[id].first_child + nodes_[id].child_count};
+    for (node_id c{lower_bound_(id, s)}; c != end && token_(c).starts_with(s);
+         ++c) {
+      pre_dq.emplace_back(token_(c));
+      find_prefix_(c, token_(c), pre_dq);
+    }
+  }
+
+  const byte *base_;
+  size_t size_;
+  const Node *nodes_{};
+  const char *tokens_{};
+};
+
+// Read-mostly trie for many readers and a background writer. Published nodes
+// are immutable: insert() copies the path it changes and publishes the new
+// root with one atomic store, so readers never wait for the writer. A retired
+// version is freed once every reader that could still see it has finished
+// (epoch based reclamation)
+class ConcurrentTrie {
+ public:
+  struct Node {
+    // sorted by token, shared with older and newer versions
+    vector<pair<string, shared_ptr<const Node>>> children{};
+
+    const Node *child(string_view token) const {
+      auto it = ranges::lower_bound(
+          children, token, {},
+          [](const auto &c) -> const string & { return c.first; });
+      if (it == children.end() || it->first != token) return nullptr;
+      return it->second.get();
+    }
+
+    deque<deque<string>> get() const {
+      deque<deque<string>> result_dq{};
+      deque<string> dq{};
+      get_(dq, result_dq);
+      return result_dq;
+    }
+
+   private:
+    void get_(deque<string> &dq, deque<deque<string>> &result_dq) const {
+      if (children.empty()) result_dq.push_back(dq);
+      for (const auto &[k, v] : children) {
+        dq.push_back(k);
+        v->get_(dq, result_dq);
+        dq.pop_back();
+      }
+    }
+  };
+
+  // Pins the version that was current when it was taken, everything reachable
+  // from root() stays valid until the snapshot is destroyed
+  class Snapshot {
+   public:
+    Snapshot(atomic<uint64_t> *slot, const Node *root)
+        : slot_{slot}, root_{root} {}
+    Snapshot(Snapshot &&o) noexcept
+        : slot_{exchange(o.slot_, nullptr)}, root_{o.root_} {}
+    Snapshot &operator=(Snapshot &&) = delete;
+    ~Snapshot() {
+      if (slot_) slot_->store(0);
+    }
+
+    const Node &root() const { return *root_; }
+
+    optional<const Node *> search(
+        const initializer_list<const char *> &il) const {
+      return search_(il.begin(), il.end());
+    }
+
+    template <token_range R>
+    optional<const Node *> search(const R &tokens) const {
+      return search_(ranges::begin(tokens), ranges::end(tokens));
+    }
+
+   private:
+    template <typename It>
+    optional<const Node *> search_(It it, It end_it) const {
+      const Node *n{root_};
+      for (; it != end_it; ++it)
+        if (!(n = n->child(*it))) return {};
+      return n;
+    }
+
+    atomic<uint64_t> *slot_;
+    const Node *root_;
+  };
+
+  ConcurrentTrie() : current_{new Version{make_shared<const Node>()}} {}
+  ConcurrentTrie(const ConcurrentTrie &) = delete;
+  ConcurrentTrie &operator=(const ConcurrentTrie &) = delete;
+  // no snapshot may outlive the trie
+  ~ConcurrentTrie() { delete current_.load(); }
+
+  // at most max_readers snapshots can be held at once, a further reader spins
+  // until one is released
+  static constexpr size_t max_readers{64};
+
+  Snapshot snapshot() const {
+    thread_local size_t hint{hash<thread::id>{}(this_thread::get_id()) %
+                             max_readers};
+    for (size_t i{hint};; i = (i + 1) % max_readers) {
+      // announce the epoch we start in before looking at current_
+      uint64_t idle{};
+      if (slots_[i].epoch.compare_exchange_strong(idle, epoch_.load())) {
+        hint = i;
+        return {&slots_[i].epoch, current_.load()->root.get()};
+      }
+      if ((i + 1) % max_readers == hint) this_thread::yield();
+    }
+  }
+
+  void insert(const initializer_list<string> &il) {
+    insert_batch(vector<vector<string>>{vector<string>(il)});
+  }
+
+  template <token_range R>
+  void insert(const R &tokens) {
+    vector<string> phrase(ranges::begin(tokens), ranges::end(tokens));
+    insert_batch({phrase});
+  }
+
+  // Copies each changed node once per batch and publishes one new version,
+  // batching amortizes the path copies of nodes near the root
+  void insert_batch(const vector<vector<string>> &phrases) {
+    vector<const vector<string> *> sorted{};
+    for (const auto &p : phrases) sorted.push_back(&p);
+    ranges::sort(sorted, {},
+                 [](const auto *p) -> const vector<string> & { return *p; });
+
+    lock_guard<mutex> lock{write_mutex_};
+    const Node *root{current_.load()->root.get()};
+    auto next = new Version{build_(root, sorted.begin(), sorted.end(), 0)};
+    const Version *old{current_.exchange(next)};
+    retired_.emplace_back(epoch_.fetch_add(1) + 1, old);
+    reclaim_();
+  }
+
+  // versions still waiting for readers, the benchmark prints it
+  size_t retired() const {
+    lock_guard<mutex> lock{write_mutex_};
+    return retired_.size();
+  }
+
+ private:
+  struct Version {
+    shared_ptr<const Node> root;
+  };
+
+  // 0 means the slot is free, otherwise the epoch its reader started in
+  struct alignas(64) Slot {
+    atomic<uint64_t> epoch{};
+  };
+
+  using phrase_it = vector<const vector<string> *>::iterator;
+
+  // new copy of old with the sorted phrases [first, last) added below depth
+  static shared_ptr<const Node> build_(const Node *old, phrase_it first,
+                                       phrase_it last, size_t depth) {
+    static const Node empty{};
+    if (!old) old = &empty;
+    auto n = make_shared<Node>();
+    n->children.reserve(old->children.size() + 1);
+    // phrases ending here sort before the ones going deeper
+    first = find_if(first, last, [=](auto *p) { return p->size() > depth; });
+    auto oc = old->children.begin();
+    while (first != last) {
+      const string &token{(**first)[depth]};
+      auto group_end = find_if(first, last,
+                               [&](auto *p) { return (*p)[depth] != token; });
+      for (; oc != old->children.end() && oc->first < token; ++oc)
+        n->children.push_back(*oc);
+      const Node *prev{};
+      if (oc != old->children.end() && oc->first == token)
+        prev = (oc++)->second.get();
+      n->children.emplace_back(token,
+                               build_(prev, first, group_end, depth + 1));
+      first = group_end;
+    }
+    n->children.insert(n->children.end(), oc, old->children.end());
+    return n;
+  }
+
+  // a version retired at epoch e can go once every active reader started at
+  // e or later, such readers loaded current_ after it was replaced
+  void reclaim_() {
+    uint64_t oldest{numeric_limits<uint64_t>::max()};
+    for (const auto &s : slots_)
+      if (uint64_t e{s.epoch.load()}; e) oldest = min(oldest, e);
+    erase_if(retired_, [=](const auto &r) { return r.first <= oldest; });
+  }
+
+  atomic<const Version *> current_;
+  mutable array<Slot, max_readers> slots_{};
+  atomic<uint64_t> epoch_{1};
+  mutable mutex write_mutex_{};
+  vector<pair<uint64_t, unique_ptr<const Version>>> retired_{};
 };
 
-void print_trie_prefix(const Trie &t, const string &prefix) {
-  auto &trie_strings = t.get();
+template <typename T>
+void print_trie_prefix(const T &t, const string &prefix) {
+  const auto &trie_strings = t.get();
   cout << format("results for \"{}...\":\n", prefix);
   for (auto &dq : trie_strings) {
     cout << format("{} ", prefix);
@@ -86,15 +1472,16 @@ void print_trie_prefix(const Trie &t, const string &prefix) {
   }
 }
 
-void print_trie_prefix(const Trie &t,
+template <typename T>
+void print_trie_prefix(const T &t,
                        const initializer_list<const char *> &prefix) {
   string sprefix{};
   for (const auto &s : prefix) sprefix += format("{} ", s);
   print_trie_prefix(t, sprefix);
 }
 
-int main() {
-  Trie ts;
+template <typename T>
+void fill_trie(T &ts) {
   ts.insert({"all", "you", "need", "is", "love"});
   ts.insert({"all", "shook", "up"});
   ts.insert({"all", "the", "best"});
@@ -105,7 +1492,10 @@ int main() {
   ts.insert({"love", "is", "the", "answer"});
   ts.insert({"loving", "you"});
   ts.insert({"long", "tall", "sally"});
+}
 
+template <typename T>
+void run_queries(const T &ts) {
   const auto prefix = {"love"};
   if (auto st = ts.search(prefix); st.has_value()) {
     print_trie_prefix(*st.value(), prefix);
@@ -118,6 +1508,24 @@ int main() {
   }
   cout << '\n';
 
+  // completions are produced lazily, take(2) stops the walk after two
+  cout << "first 2 completions of \"all...\":\n";
+  if (auto st = ts.search({"all"}); st.has_value()) {
+    for (auto path : st.value()->completions() | views::take(2)) {
+      cout << "all ";
+      for (const auto &s : path) cout << format("{} ", s);
+      cout << '\n';
+    }
+  }
+  cout << '\n';
+
+  // readers share no state, so concurrent walks are fine
+  auto count_completions = [&ts] { return ranges::distance(ts.completions()); };
+  auto f1 = async(launch::async, count_completions);
+  auto f2 = async(launch::async, count_completions);
+  cout << format("completions seen by two threads: {} {}\n\n", f1.get(),
+                 f2.get());
+
   const char *prefix3{"lo"};
   auto prefix_dq = ts.find_prefix(prefix3);
   for (const auto &s : prefix_dq) {
@@ -128,3 +1536,466 @@ int main() {
   }
   cout << '\n';
 }
+
+// phrases of 2 to 6 tokens, the first two tokens come from a small vocabulary
+// so that phrases share prefixes like real dictionaries do
+vector<vector<string>> make_phrases(size_t n, size_t vocab, unsigned seed) {
+  mt19937 rng{seed};
+  uniform_int_distribution<size_t> len_dist{2, 6};
+  vector<vector<string>> phrases(n);
+  for (auto &p : phrases) {
+    const size_t len{len_dist(rng)};
+    for (size_t i{}; i < len; ++i) {
+      const size_t words{i < 2 ? vocab / 40 + 1 : vocab};
+      p.push_back(format("w{}", rng() % words));
+    }
+  }
+  return phrases;
+}
+
+template <typename F>
+double time_ms(F &&f) {
+  auto t1 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t1)
+      .count();
+}
+
+constexpr size_t bench_phrases{20'000};
+constexpr size_t bench_vocab{4'000};
+constexpr size_t bench_lookups{200'000};
+
+// bytes per node and search latency, nodes is the node count of the trie
+template <typename T>
+void bench_trie(string_view name, const vector<vector<string>> &phrases,
+                const vector<vector<string>> &queries, size_t nodes) {
+  const size_t bytes0{g_live_bytes};
+  auto ts = make_unique<T>();
+  for (const auto &p : phrases) ts->insert(p);
+  const size_t bytes{g_live_bytes - bytes0};
+
+  size_t found{};
+  const double ms = time_ms([&] {
+    for (const auto &q : queries) found += ts->search(q).has_value();
+  });
+  cout << format("{:9} {:8.1f} bytes/node, {:6.1f} ns/search ({} found)\n",
+                 name, double(bytes) / nodes, ms * 1e6 / queries.size(),
+                 found);
+
+  size_t n{};
+  const double get_ms = time_ms([&] { n += ts->get().size(); });
+  const double lazy_ms = time_ms([&] {
+    for (auto path : ts->completions() | views::take(10)) n += path.size();
+  });
+  cout << format("{:9} get(): {:.3f} ms, first 10 completions: {:.3f} ms\n",
+                 "", get_ms, lazy_ms);
+}
+
+// startup: replaying every insert against mapping a saved image
+void bench_mapped(const FlatTrie &ft, const vector<vector<string>> &phrases,
+                  const vector<vector<string>> &queries) {
+  const auto path = filesystem::temp_directory_path() / "ch10p1trie_bench.img";
+  if (!MappedTrie::write(ft, path)) return;
+  const double insert_ms = time_ms([&] {
+    FlatTrie t;
+    for (const auto &p : phrases) t.insert(p);
+  });
+  optional<MappedTrie> mt{};
+  const double open_ms = time_ms([&] { mt = MappedTrie::open(path); });
+  if (mt.has_value()) {
+    size_t found{};
+    const double ms = time_ms([&] {
+      for (const auto &q : queries) found += mt->search(q).has_value();
+    });
+    cout << format(
+        "MappedTrie {} bytes on disk, open {:.3f} ms vs {:.1f} ms of inserts, "
+        "{:.1f} ns/search ({} found)\n",
+        filesystem::file_size(path), open_ms, insert_ms,
+        ms * 1e6 / queries.size(), found);
+  }
+  filesystem::remove(path);
+}
+
+// top_k() against collecting every completion with get() and sorting them
+void bench_top_k(const vector<vector<string>> &phrases) {
+  constexpr size_t k{10};
+  constexpr size_t num_prefixes{200};
+  mt19937 rng{5};
+  Trie t;
+  FlatTrie ft;
+  // a few heavy phrases among many light ones
+  for (const auto &p : phrases) {
+    const auto w = static_cast<uint32_t>(1 + rng() % 100 * (rng() % 100));
+    t.insert(p, w);
+    ft.insert(p, w);
+  }
+  vector<vector<string>> prefixes{};
+  for (size_t i{}; i < num_prefixes; ++i)
+    prefixes.push_back({phrases[rng() % phrases.size()][0]});
+
+  size_t n{};
+  const double trie_ms = time_ms([&] {
+    for (const auto &p : prefixes) n += t.top_k(p, k).size();
+  });
+  const double top_ms = time_ms([&] {
+    for (const auto &p : prefixes) n += ft.top_k(p, k).size();
+  });
+  // every phrase below the prefix, inner nodes included: each completion
+  // path only visits the nodes it does not share with the one before it
+  const auto all_sorted = [&](const vector<string> &p) {
+    const auto st = ft.search(p);
+    vector<pair<uint32_t, deque<string>>> all{};
+    if (st->weight()) all.emplace_back(st->weight(), deque<string>{});
+    vector<FlatTrie::Ref> refs{*st};
+    vector<string_view> prev{};
+    for (auto path : st->completions()) {
+      const size_t common = ranges::mismatch(path, prev).in1 - path.begin();
+      refs.erase(refs.begin() + common + 1, refs.end());
+      for (size_t d{common}; d < path.size(); ++d) {
+        refs.push_back(*refs.back().search(path.subspan(d, 1)));
+        if (const uint32_t w{refs.back().weight()})
+          all.emplace_back(
+              w, deque<string>(path.begin(), path.begin() + d + 1));
+      }
+      prev.assign(path.begin(), path.end());
+    }
+    const size_t m{min(k, all.size())};
+    partial_sort(all.begin(), all.begin() + m, all.end(), greater{});
+    all.resize(m);
+    return all;
+  };
+  const double sort_ms = time_ms([&] {
+    for (const auto &p : prefixes) n += all_sorted(p).size();
+  });
+  // ties may order phrases differently, so only the weights are compared
+  const auto weights_match = [](const auto &top, const auto &all) {
+    return ranges::equal(top, all, {}, &pair<deque<string>, uint32_t>::second,
+                         &pair<uint32_t, deque<string>>::first);
+  };
+  const bool same = ranges::all_of(prefixes, [&](const auto &p) {
+    const auto all = all_sorted(p);
+    return weights_match(t.top_k(p, k), all) &&
+           weights_match(ft.top_k(p, k), all);
+  });
+  cout << format("top {} of {} prefixes: Trie top_k() {:.3f} ms, FlatTrie "
+                 "top_k() {:.3f} ms, completions() + sort {:.3f} ms, same: "
+                 "{}\n",
+                 k, num_prefixes, trie_ms, top_ms, sort_ms,
+                 same ? "yes" : "NO");
+}
+
+// build_sorted() against inserting the same phrases one by one
+void bench_build(const vector<vector<string>> &phrases) {
+  auto sorted = phrases;
+  ranges::sort(sorted);
+  const size_t threads{max<size_t>(4, thread::hardware_concurrency())};
+  auto report = [&](string_view name, double ms) {
+    cout << format("{:26} {:6.2f} M phrases/s\n", name,
+                   sorted.size() / ms / 1e3);
+  };
+  cout << format("\nbuilding from {} sorted phrases:\n", sorted.size());
+  report("Trie insert", time_ms([&] {
+           Trie t;
+           for (const auto &p : sorted) t.insert(p);
+         }));
+  report("FlatTrie insert", time_ms([&] {
+           FlatTrie t;
+           for (const auto &p : sorted) t.insert(p);
+         }));
+  report("FlatTrie build_sorted", time_ms([&] {
+           auto t = FlatTrie::build_sorted(sorted);
+         }));
+  report(format("FlatTrie build_sorted x{}", threads), time_ms([&] {
+           auto t = FlatTrie::build_sorted(sorted, threads);
+         }));
+}
+
+// partial-token prefixes on a trie with a wide first level
+void bench_find_prefix() {
+  constexpr size_t num_prefixes{2'000};
+  const auto phrases = make_phrases(bench_phrases, bench_vocab * 40, 7);
+  Trie t;
+  FlatTrie ft;
+  for (const auto &p : phrases) {
+    t.insert(p);
+    ft.insert(p);
+  }
+  const auto path = filesystem::temp_directory_path() / "ch10p1trie_bench.img";
+  if (!MappedTrie::write(ft, path)) return;
+  auto mt = MappedTrie::open(path);
+  filesystem::remove(path);
+  if (!mt.has_value()) return;
+
+  mt19937 rng{8};
+  vector<string> prefixes{};
+  for (size_t i{}; i < num_prefixes; ++i)
+    prefixes.push_back(format("w{}", rng() % 4000));
+  auto bench = [&](string_view name, auto &&find_prefix) {
+    size_t n{};
+    const double ms = time_ms([&] {
+      for (const auto &p : prefixes) n += find_prefix(p.c_str());
+    });
+    cout << format("{:10} {:8.1f} ns/find_prefix ({} matches)\n", name,
+                   ms * 1e6 / prefixes.size(), n);
+  };
+  cout << format("\nfind_prefix on {} nodes, {} distinct tokens:\n",
+                 ft.size(), bench_vocab * 40);
+  // Trie::find_prefix keeps appending to the same deque
+  bench("Trie", [&, last = size_t{}](const char *s) mutable {
+    const size_t size{t.find_prefix(s).size()};
+    return size - exchange(last, size);
+  });
+  bench("FlatTrie", [&](const char *s) { return ft.find_prefix(s).size(); });
+  bench("MappedTrie", [&](const char *s) { return mt->find_prefix(s).size(); });
+}
+
+// search_batch() on several threads against one search() per query, the
+// batch holds every prefix of random phrases in random order, as typed by
+// many users
+void bench_search_batch(const vector<vector<string>> &phrases) {
+  vector<vector<string>> queries{};
+  mt19937 rng{9};
+  while (queries.size() < bench_lookups) {
+    const auto &p = phrases[rng() % phrases.size()];
+    for (size_t n{1}; n <= p.size(); ++n)
+      queries.emplace_back(p.begin(), p.begin() + n);
+  }
+  ranges::shuffle(queries, rng);
+
+  Trie t;
+  FlatTrie ft;
+  for (const auto &p : phrases) {
+    t.insert(p);
+    ft.insert(p);
+  }
+  const size_t threads{max<size_t>(4, thread::hardware_concurrency())};
+  auto report = [&](string_view name, auto &&run) {
+    size_t found{};
+    const double ms = time_ms([&] { found = run(); });
+    cout << format("{:26} {:6.2f} M queries/s ({} found)\n", name,
+                   queries.size() / ms / 1e3, found);
+  };
+  cout << format("\nbatch of {} queries:\n", queries.size());
+  // the loops keep their handles too, like search_batch() does
+  report("Trie search loop", [&] {
+    vector<optional<const Trie *>> result{};
+    for (const auto &q : queries) result.push_back(t.search(q));
+    return ranges::count(result, true, &optional<const Trie *>::has_value);
+  });
+  report("FlatTrie search loop", [&] {
+    vector<optional<FlatTrie::Ref>> result{};
+    for (const auto &q : queries) result.push_back(ft.search(q));
+    return ranges::count(result, true, &optional<FlatTrie::Ref>::has_value);
+  });
+  report(format("FlatTrie search_batch x{}", threads), [&] {
+    return ranges::count(ft.search_batch(queries, threads), true,
+                         &optional<FlatTrie::Ref>::has_value);
+  });
+}
+
+// search_within() against running the same DP over every completion
+void bench_search_within(const vector<vector<string>> &phrases) {
+  constexpr size_t num_queries{50};
+  FlatTrie ft;
+  for (const auto &p : phrases) ft.insert(p);
+  const auto all = ft.get();
+
+  // two-token prefixes of phrases with one character changed
+  mt19937 rng{10};
+  vector<vector<string>> queries{};
+  for (size_t i{}; i < num_queries; ++i) {
+    const auto &p = phrases[rng() % phrases.size()];
+    vector<string> q{p[0], p[1]};
+    string &token = q[rng() % 2];
+    token[rng() % token.size()] = 'x';
+    queries.push_back(q);
+  }
+
+  cout << format("\nfuzzy search over {} completions:\n", all.size());
+  for (size_t max_edits : {1, 2}) {
+    size_t n{};
+    const double trie_ms = time_ms([&] {
+      for (const auto &q : queries) n += ft.search_within(q, max_edits).size();
+    });
+    size_t m{};
+    const double brute_ms = time_ms([&] {
+      for (const auto &q : queries) {
+        const string query{join_tokens(q.begin(), q.end())};
+        set<deque<string>> matches{};
+        for (const auto &c : all) {
+          vector<size_t> row(query.size() + 1);
+          iota(row.begin(), row.end(), 0);
+          for (size_t i{}; i < c.size(); ++i) {
+            if (i) lev_step(row, ' ', query);
+            for (char ch : c[i]) lev_step(row, ch, query);
+            if (row.back() <= max_edits)
+              matches.emplace(c.begin(), c.begin() + i + 1);
+          }
+        }
+        m += matches.size();
+      }
+    });
+    cout << format(
+        "max {} edits: search_within {:.3f} ms/query ({} matches), brute "
+        "force {:.3f} ms/query ({} matches)\n",
+        max_edits, trie_ms / queries.size(), n, brute_ms / queries.size(),
+        m);
+  }
+}
+
+// Readers search for a fixed time while one writer keeps inserting batches.
+// LockedTrie is the Trie-behind-a-mutex setup ConcurrentTrie replaces
+struct LockedTrie {
+  Trie trie{};
+  mutable mutex m{};
+};
+
+void bench_concurrent(const vector<vector<string>> &phrases,
+                      const vector<vector<string>> &queries) {
+  constexpr auto run_time{300ms};
+  constexpr size_t batch{64};
+  const auto updates = make_phrases(phrases.size(), bench_vocab, 4);
+  const size_t max_threads{max<size_t>(4, thread::hardware_concurrency())};
+
+  auto run = [&](auto &&search, auto &&insert, size_t readers) {
+    atomic_bool stop{};
+    atomic_size_t reads{};
+    size_t writes{};
+    jthread writer{[&] {
+      for (size_t i{}; !stop; i = (i + batch) % updates.size()) {
+        insert(span{updates}.subspan(i, min(batch, updates.size() - i)));
+        writes += batch;
+      }
+    }};
+    vector<jthread> threads{};
+    for (size_t r{}; r < readers; ++r) {
+      threads.emplace_back([&, r] {
+        size_t n{};
+        for (size_t i{r * 7919}; !stop; ++i, ++n)
+          search(queries[i % queries.size()]);
+        reads += n;
+      });
+    }
+    this_thread::sleep_for(run_time);
+    stop = true;
+    threads.clear();
+    writer.join();
+    const double secs{chrono::duration<double>(run_time).count()};
+    return pair{reads / secs, writes / secs};
+  };
+
+  cout << "\nconcurrent search while one thread inserts:\n";
+  for (size_t readers{1}; readers <= max_threads; readers *= 2) {
+    LockedTrie lt{};
+    for (const auto &p : phrases) lt.trie.insert(p);
+    auto [lr, lw] = run(
+        [&](const auto &q) {
+          lock_guard<mutex> lock{lt.m};
+          return lt.trie.search(q).has_value();
+        },
+        [&](span<const vector<string>> ps) {
+          for (const auto &p : ps) {
+            lock_guard<mutex> lock{lt.m};
+            lt.trie.insert(p);
+          }
+        },
+        readers);
+
+    ConcurrentTrie ct{};
+    ct.insert_batch(phrases);
+    auto [cr, cw] = run(
+        [&](const auto &q) { return ct.snapshot().search(q).has_value(); },
+        [&](span<const vector<string>> ps) {
+          ct.insert_batch({ps.begin(), ps.end()});
+        },
+        readers);
+    cout << format(
+        "{} readers: mutex Trie {:6.2f} M searches/s ({:.0f} inserts/s), "
+        "ConcurrentTrie {:6.2f} M searches/s ({:.0f} inserts/s, {} versions "
+        "unreclaimed)\n",
+        readers, lr / 1e6, lw, cr / 1e6, cw, ct.retired());
+  }
+}
+
+int main(int argc, char *argv[]) {
+  Trie ts;
+  fill_trie(ts);
+  run_queries(ts);
+  cout << "same queries on FlatTrie:\n\n";
+  FlatTrie fts;
+  fill_trie(fts);
+  run_queries(fts);
+
+  // the image is searched in place after mapping it
+  const auto image_path = filesystem::temp_directory_path() / "ch10p1trie.img";
+  if (MappedTrie::write(fts, image_path)) {
+    if (auto mts = MappedTrie::open(image_path); mts.has_value()) {
+      cout << "same queries on MappedTrie:\n\n";
+      run_queries(*mts);
+    }
+  }
+  filesystem::remove(image_path);
+
+  // phrases inserted more often rank first
+  fts.insert({"love", "me", "do"}, 5);
+  fts.insert({"love", "is", "the", "answer"}, 2);
+  cout << "top 2 for \"love...\":\n";
+  for (const auto &[phrase, weight] : fts.top_k({"love"}, 2)) {
+    cout << "love ";
+    for (const auto &s : phrase) cout << format("{} ", s);
+    cout << format("({})\n", weight);
+  }
+  cout << '\n';
+
+  // typo-tolerant lookup, distances count characters
+  for (const auto &[phrase, edits] : ts.search_within({"lvoe", "me"}, 2)) {
+    cout << "lvoe me ~ ";
+    for (const auto &s : phrase) cout << format("{} ", s);
+    cout << format("({} edits)\n", edits);
+  }
+  cout << '\n';
+
+  // a snapshot keeps seeing the version it was taken from
+  ConcurrentTrie ct{};
+  ct.insert({"all", "the", "best"});
+  {
+    auto before = ct.snapshot();
+    ct.insert({"all", "the", "gold", "in", "california"});
+    auto after = ct.snapshot();
+    if (auto st = before.search({"all", "the"}); st.has_value())
+      print_trie_prefix(*st.value(), {"all", "the"});
+    if (auto st = after.search({"all", "the"}); st.has_value())
+      print_trie_prefix(*st.value(), {"all", "the"});
+    cout << '\n';
+  }
+
+  // the benchmarks only run on request, e.g. --bench 20000 phrases
+  if (argc < 2 || argv[1] != "--bench"sv) return 0;
+  const size_t n{argc > 2 ? stoull(argv[2]) : bench_phrases};
+  const auto phrases = make_phrases(n, bench_vocab, 1);
+  // prefixes of inserted phrases plus some misses
+  vector<vector<string>> queries{};
+  mt19937 rng{2};
+  const auto misses = make_phrases(bench_lookups / 10, bench_vocab * 2, 3);
+  for (size_t i{}; i < bench_lookups; ++i) {
+    if (i % 10 == 0) {
+      queries.push_back(misses[i / 10]);
+    } else {
+      const auto &p = phrases[rng() % phrases.size()];
+      queries.emplace_back(p.begin(), p.begin() + 1 + rng() % p.size());
+    }
+  }
+  FlatTrie ft;
+  for (const auto &p : phrases) ft.insert(p);
+  cout << format("benchmark: {} phrases, {} nodes, {} searches\n",
+                 phrases.size(), ft.size(), queries.size());
+  bench_trie<Trie>("Trie", phrases, queries, ft.size());
+  bench_trie<FlatTrie>("FlatTrie", phrases, queries, ft.size());
+  bench_mapped(ft, phrases, queries);
+  bench_top_k(phrases);
+  bench_find_prefix();
+  bench_search_batch(phrases);
+  bench_search_within(phrases);
+  bench_build(make_phrases(n * 5, bench_vocab, 6));
+  bench_concurrent(phrases, queries);
+}
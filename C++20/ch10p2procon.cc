@@ -1,4 +1,6 @@
 #include <bits/stdc++.h>
+#include <sys/resource.h>
+#include <unistd.h>
 
 using namespace std;
 using namespace std::chrono_literals;
@@ -10,42 +12,1533 @@ constexpr size_t num_items{15};
 constexpr size_t num_producers{3};
 constexpr size_t num_consumers{5};
 
-deque<string> qs{};
-mutex q_mutex{};
-condition_variable cv_producer{};
-condition_variable cv_consumer{};
-bool production_complete{};
+constexpr size_t cache_line{64};
+
+// counts every allocation, to show that pooled messages need none
+atomic_size_t g_allocations{};
+
+constexpr align_val_t malloc_align{alignof(max_align_t)};
+
+// all forms of global new and delete, nothrow included, count through
+// these two; noinline keeps GCC from pairing a new with free()
+[[gnu::noinline]] void *counted_alloc(size_t n, align_val_t align) noexcept {
+  const size_t a{static_cast<size_t>(align)};
+  n = max(n, size_t{1});
+  void *p{a <= alignof(max_align_t) ? malloc(n)
+                                     : aligned_alloc(a, (n + a - 1) / a * a)};
+  if (p) ++g_allocations;
+  return p;
+}
+[[gnu::noinline]] void counted_free(void *p) noexcept {
+  free(p);
+}
+
+void *counted_new(size_t n, align_val_t a) {
+  if (void *p = counted_alloc(n, a)) return p;
+  throw bad_alloc{};
+}
+
+void *operator new(size_t n) { return counted_new(n, malloc_align); }
+void *operator new[](size_t n) { return counted_new(n, malloc_align); }
+void *operator new(size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new[](size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new(size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new[](size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new(size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void *operator new[](size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, size_t) noexcept { counted_free(p); }
+void operator delete(void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete[](void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, const nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+
+// The deque/mutex/two-condvar queue: producers wait while it is full,
+// consumers wait (at most timeout) while it is empty
+template <typename T>
+class LockedQueue {
+ public:
+  explicit LockedQueue(size_t limit) : limit_{limit} {}
+
+  void push(T v) {
+    unique_lock<mutex> lock(m_);
+    // wait when predicate is false (i.e., full queue)
+    // rerun when notified and predicate is true
+    cv_producer_.wait(lock, [&] { return q_.size() < limit_; });
+    q_.push_back(move(v));
+    cv_consumer_.notify_all();
+  }
+
+  optional<T> pop_for(chrono::steady_clock::duration timeout) {
+    unique_lock<mutex> lock(m_);
+    // wait when predicate is false (i.e., empty queue)
+    // rerun when (notified or timeout) and predicate is true
+    cv_consumer_.wait_for(lock, timeout, [&] { return !q_.empty(); });
+    if (q_.empty()) return {};
+    T v{move(q_.front())};
+    q_.pop_front();
+    cv_producer_.notify_all();
+    return v;
+  }
+
+  size_t size() const {
+    lock_guard<mutex> lock(m_);
+    return q_.size();
+  }
+
+ private:
+  deque<T> q_{};
+  const size_t limit_;
+  mutable mutex m_{};
+  condition_variable cv_producer_{};
+  condition_variable cv_consumer_{};
+};
+
+// tells the core we are in a spin loop, which saves power and lets the
+// other hyperthread run
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+// Spins first, then yields, then sleeps for growing intervals. Used by the
+// blocking operations of MpmcQueue, which has nothing to sleep on
+class Backoff {
+ public:
+  void operator()() {
+    if (n_ < spins_) {
+      ++n_;
+      cpu_relax();
+    } else if (n_ < spins_ + yields_) {
+      ++n_;
+      this_thread::yield();
+    } else {
+      this_thread::sleep_for(sleep_);
+      sleep_ = min(sleep_ * 2, max_sleep_);
+    }
+  }
+
+ private:
+  static constexpr size_t spins_{64};
+  static constexpr size_t yields_{64};
+  static constexpr chrono::microseconds max_sleep_{1ms};
+  size_t n_{};
+  chrono::microseconds sleep_{10us};
+};
+
+enum class WaitMode { low_latency, power_saving };
+
+// Waits for a condition in three stages: spin with cpu_relax(), yield, then
+// park on an atomic until notify(). The spin budget tunes itself: a wait
+// that ends while spinning pulls it toward twice the spins it took, one
+// that only ends while yielding doubles it, and one that had to park
+// shrinks it. low_latency lets the budget grow large and yields before
+// parking, power_saving keeps spins short and parks right after them. On a
+// single core nothing can change while we spin, so there is no spin stage
+class alignas(cache_line) SpinPark {
+ public:
+  explicit SpinPark(WaitMode mode = WaitMode::low_latency)
+      : max_spins_{thread::hardware_concurrency() <= 1 ? 0u
+                   : mode == WaitMode::low_latency     ? 16'384u
+                                                       : 128u},
+        yields_{mode == WaitMode::low_latency ? 32u : 0u},
+        spins_{min(min_spins_ * 8, max_spins_)} {}
+
+  // ready() is retried until it returns true, it may do the work itself
+  // (like a try_pop) as long as it only returns true when it succeeded
+  template <typename Ready>
+  void wait(Ready ready) {
+    if (ready()) return;
+    const uint32_t budget{spins_.load(memory_order_relaxed)};
+    for (uint32_t i{1}; i <= budget; ++i) {
+      cpu_relax();
+      if (ready()) {
+        tune_(min(2 * i, max_spins_));
+        return;
+      }
+    }
+    for (uint32_t i{}; i < yields_; ++i) {
+      this_thread::yield();
+      if (ready()) {
+        tune_(min(2 * budget, max_spins_));
+        return;
+      }
+    }
+    for (;;) {
+      const uint32_t epoch{epoch_.load()};
+      ++parked_;
+      // pairs with the fence in notify(): either it sees us parked or we
+      // see the change it announces
+      atomic_thread_fence(memory_order_seq_cst);
+      const bool done{ready()};
+      if (!done) epoch_.wait(epoch);
+      --parked_;
+      if (done || ready()) break;
+    }
+    tune_(budget - budget / 4);
+  }
+
+  // call after every change that may make a waiter's condition true
+  void notify() {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (parked_.load(memory_order_relaxed)) {
+      ++epoch_;
+      epoch_.notify_one();
+    }
+  }
+
+  // wakes every parked waiter, e.g. when a queue is closed
+  void notify_all() {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (parked_.load(memory_order_relaxed)) {
+      ++epoch_;
+      epoch_.notify_all();
+    }
+  }
+
+  uint32_t spin_budget() const { return spins_.load(memory_order_relaxed); }
+
+ private:
+  static constexpr uint32_t min_spins_{16};
+
+  // moving average, racing waiters may lose each other's updates
+  void tune_(uint32_t target) {
+    const uint32_t s{spins_.load(memory_order_relaxed)};
+    spins_.store(clamp((s * 7 + target) / 8, min(min_spins_, max_spins_),
+                       max_spins_),
+                 memory_order_relaxed);
+  }
+
+  const uint32_t max_spins_;
+  const uint32_t yields_;
+  atomic<uint32_t> spins_;
+  atomic<uint32_t> epoch_{};
+  atomic<uint32_t> parked_{};
+};
+
+// Bounded multi-producer/multi-consumer ring without locks. Each slot has a
+// sequence number: seq == pos means the slot is free for the producer that
+// claimed position pos, seq == pos + 1 means it holds that producer's item.
+// Producers only race on tail_ and consumers on head_, and the two indices
+// live on separate cache lines
+template <typename T>
+class MpmcQueue {
+ public:
+  explicit MpmcQueue(size_t capacity)
+      : capacity_{capacity}, slots_(make_unique<Slot[]>(capacity)) {
+    for (size_t i{}; i < capacity_; ++i) slots_[i].seq.store(i);
+  }
+
+  // v is moved from only when it was queued
+  bool try_push(T &v) {
+    size_t pos{tail_.load(memory_order_relaxed)};
+    for (;;) {
+      Slot &s = slots_[pos % capacity_];
+      const size_t seq{s.seq.load(memory_order_acquire)};
+      const auto diff = static_cast<ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        memory_order_relaxed)) {
+          s.value = move(v);
+          s.seq.store(pos + 1, memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;  // full: the slot still holds the previous lap
+      } else {
+        pos = tail_.load(memory_order_relaxed);
+      }
+    }
+  }
+
+  optional<T> try_pop() {
+    size_t pos{head_.load(memory_order_relaxed)};
+    for (;;) {
+      Slot &s = slots_[pos % capacity_];
+      const size_t seq{s.seq.load(memory_order_acquire)};
+      const auto diff = static_cast<ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        memory_order_relaxed)) {
+          optional<T> v{move(s.value)};
+          s.seq.store(pos + capacity_, memory_order_release);
+          return v;
+        }
+      } else if (diff < 0) {
+        return {};  // empty: the slot was not written in this lap yet
+      } else {
+        pos = head_.load(memory_order_relaxed);
+      }
+    }
+  }
+
+  // Queues a prefix of items with a single CAS on tail_ and returns its
+  // length, only the queued items are moved from
+  size_t try_push_batch(span<T> items) {
+    size_t pos{tail_.load(memory_order_relaxed)};
+    while (!items.empty()) {
+      size_t n{};
+      while (n < min(items.size(), capacity_) &&
+             slots_[(pos + n) % capacity_].seq.load(memory_order_acquire) ==
+                 pos + n)
+        ++n;
+      if (!n) {
+        const size_t seq{slots_[pos % capacity_].seq.load()};
+        if (static_cast<ptrdiff_t>(seq - pos) < 0) return 0;  // full
+        pos = tail_.load(memory_order_relaxed);
+      } else if (tail_.compare_exchange_weak(pos, pos + n,
+                                             memory_order_relaxed)) {
+        for (size_t i{}; i < n; ++i) {
+          Slot &s = slots_[(pos + i) % capacity_];
+          s.value = move(items[i]);
+          s.seq.store(pos + i + 1, memory_order_release);
+        }
+        return n;
+      }
+    }
+    return 0;
+  }
+
+  // Takes up to out.size() items with a single CAS on head_ and returns how
+  // many were written to the front of out
+  size_t try_pop_batch(span<T> out) {
+    size_t pos{head_.load(memory_order_relaxed)};
+    while (!out.empty()) {
+      size_t n{};
+      while (n < min(out.size(), capacity_) &&
+             slots_[(pos + n) % capacity_].seq.load(memory_order_acquire) ==
+                 pos + n + 1)
+        ++n;
+      if (!n) {
+        const size_t seq{slots_[pos % capacity_].seq.load()};
+        if (static_cast<ptrdiff_t>(seq - (pos + 1)) < 0) return 0;  // empty
+        pos = head_.load(memory_order_relaxed);
+      } else if (head_.compare_exchange_weak(pos, pos + n,
+                                             memory_order_relaxed)) {
+        for (size_t i{}; i < n; ++i) {
+          Slot &s = slots_[(pos + i) % capacity_];
+          out[i] = move(s.value);
+          s.seq.store(pos + i + capacity_, memory_order_release);
+        }
+        return n;
+      }
+    }
+    return 0;
+  }
+
+  // same contract as LockedQueue
+  void push(T v) {
+    for (Backoff backoff{}; !try_push(v);) backoff();
+  }
+
+  optional<T> pop_for(chrono::steady_clock::duration timeout) {
+    const auto deadline = chrono::steady_clock::now() + timeout;
+    for (Backoff backoff{};; backoff()) {
+      if (auto v = try_pop()) return v;
+      if (chrono::steady_clock::now() >= deadline) return {};
+    }
+  }
+
+  // a snapshot, may be stale by the time it is used
+  size_t size() const {
+    const size_t head{head_.load()}, tail{tail_.load()};
+    return tail > head ? tail - head : 0;
+  }
+
+ private:
+  struct alignas(cache_line) Slot {
+    atomic<size_t> seq{};
+    T value{};
+  };
+
+  const size_t capacity_;
+  unique_ptr<Slot[]> slots_;
+  alignas(cache_line) atomic<size_t> head_{};
+  alignas(cache_line) atomic<size_t> tail_{};
+};
+
+// MpmcQueue whose blocking operations wait through a SpinPark on either
+// side, so a waiter parks instead of sleeping a fixed interval and is woken
+// by the next push or pop
+template <typename T>
+class ParkingQueue {
+ public:
+  explicit ParkingQueue(size_t capacity,
+                        WaitMode mode = WaitMode::low_latency)
+      : q_{capacity}, not_full_{mode}, not_empty_{mode} {}
+
+  void push(T v) {
+    not_full_.wait([&] { return q_.try_push(v); });
+    not_empty_.notify();
+  }
+
+  T pop() {
+    optional<T> v{};
+    not_empty_.wait([&] { return (v = q_.try_pop()).has_value(); });
+    not_full_.notify();
+    return move(*v);
+  }
+
+  uint32_t pop_spin_budget() const { return not_empty_.spin_budget(); }
+
+ private:
+  MpmcQueue<T> q_;
+  SpinPark not_full_;
+  SpinPark not_empty_;
+};
+
+// Counters kept by a Channel, read with Channel::stats()
+struct ChannelStats {
+  size_t sent{};
+  size_t received{};
+  size_t depth{};      // items queued right now
+  size_t max_depth{};  // high-water mark
+  chrono::nanoseconds send_blocked{};  // summed over all senders
+  chrono::nanoseconds recv_idle{};     // summed over all receivers
+  chrono::duration<double> elapsed{};  // since the channel was created
+
+  double items_per_sec() const { return received / elapsed.count(); }
+};
+
+// Bounded queue that can be closed, built on MpmcQueue with a SpinPark on
+// either side like ParkingQueue. Senders wait while it is full and
+// receivers while it is empty; after close() sends fail, receivers drain
+// what is left and then get nullopt instead of waiting. A send racing with
+// close() may still get its item in, a receiver that is still draining
+// takes it. send_many/recv_many move a whole batch per CAS, and the time
+// spent waiting on either side is tracked in stats()
+template <typename T>
+class Channel {
+ public:
+  explicit Channel(size_t capacity, WaitMode mode = WaitMode::low_latency)
+      : q_{capacity}, capacity_{capacity}, not_full_{mode}, not_empty_{mode} {}
+
+  // false when the channel was closed, v is dropped then
+  bool send(T v) {
+    bool sent{};
+    wait_(not_full_, send_blocked_, [&] {
+      return closed_.load() || (sent = q_.try_push(v));
+    });
+    if (!sent) return false;
+    count_sent_(1);
+    not_empty_.notify();
+    return true;
+  }
+
+  // Sends all items, as many per CAS as there is room for, and returns how
+  // many were sent before the channel was closed. Sent items are moved from
+  size_t send_many(span<T> items) {
+    size_t sent{};
+    while (sent < items.size()) {
+      size_t n{};
+      wait_(not_full_, send_blocked_, [&] {
+        return closed_.load() ||
+               (n = q_.try_push_batch(items.subspan(sent))) > 0;
+      });
+      if (!n) break;
+      sent += n;
+      count_sent_(n);
+      if (n > 1) {
+        not_empty_.notify_all();
+      } else {
+        not_empty_.notify();
+      }
+    }
+    return sent;
+  }
+
+  // nullopt once the channel is closed and empty
+  optional<T> recv() {
+    optional<T> v{};
+    wait_(not_empty_, recv_idle_, [&] { return pop_(v) || closed_.load(); });
+    // sends that finished before close() are visible once closed_ is seen
+    if (!v) pop_(v);
+    return v;
+  }
+
+  optional<T> try_recv() {
+    optional<T> v{};
+    pop_(v);
+    return v;
+  }
+
+  // SpinPark cannot time out, so this one backs off like MpmcQueue::pop_for
+  optional<T> recv_for(chrono::steady_clock::duration timeout) {
+    optional<T> v{};
+    const auto deadline = chrono::steady_clock::now() + timeout;
+    for (Backoff backoff{};
+         !pop_(v) && !closed_ && chrono::steady_clock::now() < deadline;
+         backoff()) {
+    }
+    return v;
+  }
+
+  // waits for at least one item and takes up to n, empty once the channel
+  // is closed and drained. n must be positive so that empty always means
+  // closed
+  vector<T> recv_many(size_t n) {
+    if (!n) throw invalid_argument{"Channel::recv_many: n must be positive"};
+    vector<T> out(min(n, capacity_));
+    size_t got{};
+    wait_(not_empty_, recv_idle_, [&] {
+      return (got = q_.try_pop_batch(out)) > 0 || closed_.load();
+    });
+    if (!got) got = q_.try_pop_batch(out);
+    out.resize(got);
+    received_ += got;
+    if (got > 1) {
+      not_full_.notify_all();
+    } else if (got) {
+      not_full_.notify();
+    }
+    return out;
+  }
+
+  void close() {
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  bool closed() const { return closed_.load(); }
+
+  size_t size() const { return q_.size(); }
+
+  // the counters are read one by one while the channel may still be in use
+  ChannelStats stats() const {
+    return {sent_.load(),
+            received_.load(),
+            q_.size(),
+            max_depth_.load(),
+            chrono::nanoseconds{send_blocked_.load()},
+            chrono::nanoseconds{recv_idle_.load()},
+            chrono::steady_clock::now() - created_};
+  }
+
+ private:
+  // the clock is only read when the caller really has to wait
+  template <typename Ready>
+  static void wait_(SpinPark &park, atomic<int64_t> &total, Ready ready) {
+    if (ready()) return;
+    const auto t1 = chrono::steady_clock::now();
+    park.wait(ready);
+    total += (chrono::steady_clock::now() - t1).count();
+  }
+
+  void count_sent_(size_t n) {
+    sent_ += n;
+    const size_t depth{q_.size()};
+    for (size_t m{max_depth_.load(memory_order_relaxed)};
+         depth > m && !max_depth_.compare_exchange_weak(m, depth);) {
+    }
+  }
+
+  bool pop_(optional<T> &v) {
+    if (!(v = q_.try_pop())) return false;
+    ++received_;
+    not_full_.notify();
+    return true;
+  }
+
+  MpmcQueue<T> q_;
+  const size_t capacity_;
+  const chrono::steady_clock::time_point created_{chrono::steady_clock::now()};
+  atomic<bool> closed_{};
+  SpinPark not_full_;
+  SpinPark not_empty_;
+  // producer and consumer counters live on separate cache lines
+  alignas(cache_line) atomic<size_t> sent_{};
+  atomic<size_t> max_depth_{};
+  atomic<int64_t> send_blocked_{};
+  alignas(cache_line) atomic<size_t> received_{};
+  atomic<int64_t> recv_idle_{};
+};
+
+// Fixed number of fixed-size text buffers. A producer formats straight
+// into a slot it acquired, the slot travels through the queue as a Message
+// and goes back on the free list when the consumer drops that Message, so
+// no message allocates once the pool exists. Text longer than a slot is
+// truncated
+class MessagePool {
+ public:
+  static constexpr size_t slot_size{64};
+
+  class Message {
+   public:
+    Message() = default;
+    Message(Message &&o) noexcept
+        : pool_{exchange(o.pool_, nullptr)}, slot_{o.slot_} {}
+    Message &operator=(Message &&o) noexcept {
+      if (this != &o) {
+        release_();
+        pool_ = exchange(o.pool_, nullptr);
+        slot_ = o.slot_;
+      }
+      return *this;
+    }
+    ~Message() { release_(); }
+
+    template <typename... Args>
+    void format(format_string<Args...> fmt, Args &&...args) {
+      Slot &s = pool_->slots_[slot_];
+      const auto r =
+          format_to_n(s.text, slot_size, fmt, forward<Args>(args)...);
+      s.size = min<size_t>(r.size, slot_size);
+    }
+
+    string_view view() const {
+      const Slot &s = pool_->slots_[slot_];
+      return {s.text, s.size};
+    }
+
+   private:
+    friend class MessagePool;
+    Message(MessagePool *pool, uint32_t slot) : pool_{pool}, slot_{slot} {}
+
+    void release_() {
+      if (pool_) {
+        auto i = slot_;
+        pool_->free_.try_push(i);  // never full, it has room for every slot
+        pool_ = nullptr;
+      }
+    }
+
+    MessagePool *pool_{};
+    uint32_t slot_{};
+  };
+
+  explicit MessagePool(size_t slots)
+      : slots_(make_unique<Slot[]>(slots)), free_{slots} {
+    for (uint32_t i{}; i < slots; ++i) free_.try_push(i);
+  }
+
+  optional<Message> try_acquire() {
+    if (auto i = free_.try_pop()) return Message{this, *i};
+    return {};
+  }
+
+  // waits while every slot is in use, which throttles producers that run
+  // ahead of the consumers
+  Message acquire() {
+    for (Backoff backoff{};; backoff())
+      if (auto m = try_acquire()) return move(*m);
+  }
+
+ private:
+  struct Slot {
+    size_t size{};
+    char text[slot_size];
+  };
+
+  unique_ptr<Slot[]> slots_;
+  MpmcQueue<uint32_t> free_;
+};
+
+// Runs tasks on a fixed set of workers that share one locked deque, the
+// baseline for WorkStealingPool
+class GlobalQueuePool {
+ public:
+  using Task = function<void()>;
+
+  explicit GlobalQueuePool(size_t workers) {
+    for (size_t i{}; i < workers; ++i)
+      threads_.emplace_back([this](stop_token st) { run_(st); });
+  }
+
+  void spawn(Task t) {
+    ++pending_;
+    {
+      lock_guard<mutex> lock(m_);
+      tasks_.push_back(move(t));
+    }
+    cv_.notify_one();
+  }
+
+  // waits until every spawned task, including those spawned by tasks, ran
+  void wait_idle() {
+    for (size_t n{pending_}; n; n = pending_) pending_.wait(n);
+  }
+
+ private:
+  void run_(stop_token st) {
+    for (;;) {
+      unique_lock<mutex> lock(m_);
+      if (!cv_.wait(lock, st, [&] { return !tasks_.empty(); })) return;
+      Task t{move(tasks_.front())};
+      tasks_.pop_front();
+      lock.unlock();
+      t();
+      if (--pending_ == 0) pending_.notify_all();
+    }
+  }
+
+  deque<Task> tasks_{};
+  mutex m_{};
+  condition_variable_any cv_{};
+  atomic_size_t pending_{};
+  vector<jthread> threads_{};  // last, so workers stop before the rest goes
+};
+
+// Runs tasks on a fixed set of workers, each with its own deque. A worker
+// pushes and pops its own tasks at the back, newest first, so subtasks run
+// where their data is still in cache; an idle worker steals the oldest task
+// from the front of a random victim, and sleeps when there is nothing to
+// steal. Tasks spawned from a worker go to that worker's deque, others are
+// dealt round-robin. Tasks not started when the pool is destroyed are
+// dropped
+class WorkStealingPool {
+ public:
+  using Task = function<void()>;
+
+  explicit WorkStealingPool(size_t workers) : workers_(workers) {
+    for (size_t i{}; i < workers; ++i)
+      threads_.emplace_back([this, i](stop_token st) { run_(st, i); });
+  }
+
+  void spawn(Task t) {
+    ++pending_;
+    Worker &w = workers_[current_pool_ == this
+                             ? current_worker_
+                             : next_++ % workers_.size()];
+    {
+      lock_guard<mutex> lock(w.m);
+      w.tasks.push_back(move(t));
+    }
+    // pairs with the check of queued_ by a worker going to sleep: either it
+    // sees the task or we see it sleeping
+    ++queued_;
+    if (sleepers_) {
+      lock_guard<mutex> lock(sleep_m_);
+      sleep_cv_.notify_one();
+    }
+  }
+
+  // waits until every spawned task, including those spawned by tasks, ran
+  void wait_idle() {
+    for (size_t n{pending_}; n; n = pending_) pending_.wait(n);
+  }
+
+ private:
+  struct alignas(cache_line) Worker {
+    mutex m{};
+    deque<Task> tasks{};
+  };
+
+  optional<Task> pop_(size_t self, minstd_rand &rng) {
+    const auto take = [](Worker &w, bool back) -> optional<Task> {
+      lock_guard<mutex> lock(w.m);
+      if (w.tasks.empty()) return {};
+      optional<Task> t{};
+      if (back) {
+        t = move(w.tasks.back());
+        w.tasks.pop_back();
+      } else {
+        t = move(w.tasks.front());
+        w.tasks.pop_front();
+      }
+      return t;
+    };
+    if (auto t = take(workers_[self], true)) return t;
+    const size_t n{workers_.size()}, first{rng() % n};
+    for (size_t i{}; i < n; ++i) {
+      const size_t victim{(first + i) % n};
+      if (victim == self) continue;
+      if (auto t = take(workers_[victim], false)) return t;
+    }
+    return {};
+  }
+
+  void run_(stop_token st, size_t self) {
+    current_pool_ = this;
+    current_worker_ = self;
+    minstd_rand rng(static_cast<uint32_t>(self + 1));
+    while (!st.stop_requested()) {
+      if (auto t = pop_(self, rng)) {
+        --queued_;
+        (*t)();
+        if (--pending_ == 0) pending_.notify_all();
+        continue;
+      }
+      unique_lock<mutex> lock(sleep_m_);
+      ++sleepers_;
+      sleep_cv_.wait(lock, st, [&] { return queued_ > 0; });
+      --sleepers_;
+    }
+  }
+
+  static inline thread_local WorkStealingPool *current_pool_{};
+  static inline thread_local size_t current_worker_{};
+
+  vector<Worker> workers_;
+  atomic_size_t next_{};
+  atomic<ptrdiff_t> queued_{};  // may dip below 0 between pop and push count
+  atomic_size_t pending_{};     // spawned and not finished
+  atomic_size_t sleepers_{};
+  mutex sleep_m_{};
+  condition_variable_any sleep_cv_{};
+  vector<jthread> threads_{};  // last, so workers stop before the rest goes
+};
+
+class CoroPool;
+
+// A coroutine started by CoroPool::spawn. It starts suspended, runs on the
+// pool's workers and frees its frame when it returns
+class Task {
+ public:
+  struct promise_type {
+    // bytes of every coroutine frame ever allocated, to compare with stacks
+    static inline atomic_size_t frame_bytes{};
+
+    static void *operator new(size_t n) {
+      frame_bytes += n;
+      return ::operator new(n);
+    }
+    static void operator delete(void *p) noexcept { ::operator delete(p); }
+
+    Task get_return_object() {
+      return Task{coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept;
+    void return_void() {}
+    void unhandled_exception() { terminate(); }
+
+    CoroPool *pool{};
+  };
+
+  Task(Task &&o) noexcept : h_{exchange(o.h_, {})} {}
+  ~Task() {
+    if (h_) h_.destroy();
+  }
+
+ private:
+  friend class CoroPool;
+  explicit Task(coroutine_handle<promise_type> h) : h_{h} {}
+
+  coroutine_handle<promise_type> h_{};
+};
+
+// Runs coroutines on a WorkStealingPool. A coroutine that is resumed from
+// a worker is queued on that worker, so a sender and the receiver it wakes
+// tend to stay on one thread. wait_idle() waits for every spawned Task to
+// return
+class CoroPool {
+ public:
+  explicit CoroPool(size_t workers) : pool_{workers} {}
+
+  void spawn(Task t) {
+    ++live_;
+    t.h_.promise().pool = this;
+    schedule(exchange(t.h_, {}));
+  }
+
+  void schedule(coroutine_handle<> h) {
+    pool_.spawn([h] { h.resume(); });
+  }
+
+  void wait_idle() {
+    for (size_t n{live_}; n; n = live_) live_.wait(n);
+  }
+
+ private:
+  friend struct Task::promise_type;
+
+  void finished_() {
+    if (--live_ == 0) live_.notify_all();
+  }
+
+  atomic_size_t live_{};
+  WorkStealingPool pool_;  // last, so workers stop before the rest goes
+};
+
+inline auto Task::promise_type::final_suspend() noexcept {
+  struct Final {
+    bool await_ready() noexcept { return false; }
+    void await_suspend(coroutine_handle<promise_type> h) noexcept {
+      CoroPool *pool{h.promise().pool};
+      h.destroy();
+      pool->finished_();
+    }
+    void await_resume() noexcept {}
+  };
+  return Final{};
+}
+
+// Channel for coroutines: co_await send(v) and co_await recv() suspend the
+// coroutine instead of blocking its thread, and whoever frees room or
+// brings an item hands the waiter back to the CoroPool. A sender that finds
+// a waiting receiver gives it the item directly. Same close() semantics as
+// Channel. Waiters are linked through their awaiters, so waiting allocates
+// nothing
+template <typename T>
+class AsyncChannel {
+  template <typename A>
+  struct WaitList {
+    A *head{};
+    A *tail{};
+
+    void push(A *a) {
+      a->next = nullptr;
+      (tail ? tail->next : head) = a;
+      tail = a;
+    }
+    A *pop() {
+      A *a{head};
+      if (a && !(head = a->next)) tail = nullptr;
+      return a;
+    }
+  };
+
+ public:
+  struct SendAwaiter {
+    AsyncChannel &ch;
+    T v;
+    bool ok{};
+    coroutine_handle<> h{};
+    SendAwaiter *next{};
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(coroutine_handle<> caller) {
+      unique_lock<mutex> lock(ch.m_);
+      if (ch.closed_) return false;
+      if (auto *r = ch.receivers_.pop()) {
+        r->v = move(v);
+        ok = true;
+        lock.unlock();
+        ch.pool_.schedule(r->h);
+        return false;
+      }
+      if (ch.count_ < ch.ring_.size()) {
+        ch.put_(move(v));
+        ok = true;
+        return false;
+      }
+      h = caller;
+      ch.senders_.push(this);
+      return true;
+    }
+    // false when the channel was closed, the item is dropped then
+    bool await_resume() const noexcept { return ok; }
+  };
+
+  struct RecvAwaiter {
+    AsyncChannel &ch;
+    optional<T> v{};
+    coroutine_handle<> h{};
+    RecvAwaiter *next{};
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(coroutine_handle<> caller) {
+      unique_lock<mutex> lock(ch.m_);
+      if (ch.count_) {
+        v = ch.take_();
+        if (auto *s = ch.senders_.pop()) {
+          ch.put_(move(s->v));
+          s->ok = true;
+          lock.unlock();
+          ch.pool_.schedule(s->h);
+        }
+        return false;
+      }
+      if (ch.closed_) return false;
+      h = caller;
+      ch.receivers_.push(this);
+      return true;
+    }
+    // nullopt once the channel is closed and empty
+    optional<T> await_resume() { return move(v); }
+  };
+
+  AsyncChannel(CoroPool &pool, size_t capacity)
+      : pool_{pool}, ring_(capacity) {}
+
+  SendAwaiter send(T v) { return {*this, move(v)}; }
+  RecvAwaiter recv() { return {*this}; }
+
+  void close() {
+    vector<coroutine_handle<>> wake{};
+    {
+      lock_guard<mutex> lock(m_);
+      closed_ = true;
+      // receivers only wait on an empty channel, senders on a full one
+      while (auto *r = receivers_.pop()) wake.push_back(r->h);
+      while (auto *s = senders_.pop()) wake.push_back(s->h);
+    }
+    for (auto h : wake) pool_.schedule(h);
+  }
+
+ private:
+  void put_(T v) {
+    ring_[(head_ + count_) % ring_.size()] = move(v);
+    ++count_;
+  }
+
+  T take_() {
+    T v{move(ring_[head_])};
+    head_ = (head_ + 1) % ring_.size();
+    --count_;
+    return v;
+  }
+
+  CoroPool &pool_;
+  vector<T> ring_;
+  size_t head_{};
+  size_t count_{};
+  bool closed_{};
+  WaitList<SendAwaiter> senders_{};
+  WaitList<RecvAwaiter> receivers_{};
+  mutex m_{};
+};
+
+// every message is either queued or held by one producer or consumer
+MessagePool pool{queue_limit + num_producers + num_consumers};
+Channel<MessagePool::Message> qs{queue_limit};
 
 void producer(const size_t id) {
   for (size_t i{}; i < num_items; ++i) {
     this_thread::sleep_for(delay_time * id);
-    unique_lock<mutex> lock(q_mutex);
-    // wait when predicate is false (i.e., full queue)
-    // rerun when notified and predicate is true
-    cv_producer.wait(lock, [&] { return qs.size() < queue_limit; });
-    qs.push_back(format("pid {}, qs {}, item {:02}\n", id, qs.size(), i + 1));
-    cv_consumer.notify_all();
+    auto m = pool.acquire();
+    m.format("pid {}, qs {}, item {:02}\n", id, qs.size(), i + 1);
+    // waits while the channel is full
+    qs.send(move(m));
   }
 }
 
 void consumer(const size_t id) {
-  while (!production_complete) {
-    unique_lock<mutex> lock(q_mutex);
-    // wait when predicate is false (i.e., empty queue)
-    // rerun when (notified or timeout) and predicate is true
-    // timeout prevents that task finishes but consumer is still waiting
-    cv_consumer.wait_for(lock, consumer_wait, [&] { return !qs.empty(); });
-    if (!qs.empty()) {
-      cout << format("cid {}: {}", id, qs.front());
-      qs.pop_front();
+  // returns once the channel is closed and drained; each line is formatted
+  // on the stack and written with one call so lines do not interleave
+  char line[MessagePool::slot_size + 32];
+  while (auto m = qs.recv()) {
+    const auto r =
+        format_to_n(line, sizeof line, "cid {}: {}", id, m->view());
+    cout.write(line, min<ptrdiff_t>(r.size, sizeof line));
+  }
+}
+
+template <typename F>
+double time_ms(F &&f) {
+  auto t1 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t1)
+      .count();
+}
+
+// Throughput and enqueue-to-dequeue latency of a queue for a number of
+// producers and consumers, every item carries the time it was pushed
+template <typename Q>
+pair<double, double> bench_queue(size_t producers, size_t consumers,
+                                 size_t items) {
+  using clock = chrono::steady_clock;
+  Q q{1024};
+  atomic_size_t consumed{};
+  vector<vector<float>> latencies(consumers);
+  const auto t1 = clock::now();
+  {
+    vector<jthread> threads{};
+    for (size_t p{}; p < producers; ++p) {
+      threads.emplace_back([&, p] {
+        const size_t n{items / producers + (p < items % producers)};
+        for (size_t i{}; i < n; ++i) q.push(clock::now());
+      });
+    }
+    for (size_t c{}; c < consumers; ++c) {
+      threads.emplace_back([&, c] {
+        while (consumed < items) {
+          if (auto t = q.pop_for(1ms)) {
+            latencies[c].push_back(
+                chrono::duration<float, micro>(clock::now() - *t).count());
+            ++consumed;
+          }
+        }
+      });
+    }
+  }
+  const chrono::duration<double> secs{clock::now() - t1};
+  vector<float> all{};
+  for (const auto &l : latencies) all.insert(all.end(), l.begin(), l.end());
+  const auto p99 = all.begin() + all.size() * 99 / 100;
+  ranges::nth_element(all, p99);
+  return {items / secs.count(), *p99};
+}
+
+// Items per lock/CAS: 4 producers and 4 consumers move items through a
+// queue in batches of the given size
+void bench_batch(size_t items) {
+  constexpr size_t producers{4}, consumers{4}, capacity{256};
+  cout << format("\n{} items, {} producers, {} consumers, capacity {}:\n",
+                 items, producers, consumers, capacity);
+  cout << "batch  Channel items/s  blocked ms  idle ms  max depth  "
+          "MpmcQueue items/s\n";
+  for (size_t batch : {1, 4, 16, 64}) {
+    Channel<size_t> ch{capacity};
+    {
+      vector<jthread> threads{};
+      for (size_t p{}; p < producers; ++p) {
+        threads.emplace_back([&] {
+          vector<size_t> buf(batch);
+          for (size_t i{}; i < items / producers; i += batch) {
+            if (batch == 1) {
+              ch.send(i);
+            } else {
+              ch.send_many(buf);
+            }
+          }
+        });
+      }
+      for (size_t c{}; c < consumers; ++c) {
+        threads.emplace_back([&] {
+          if (batch == 1) {
+            while (ch.recv()) {
+            }
+          } else {
+            while (!ch.recv_many(batch).empty()) {
+            }
+          }
+        });
+      }
+      for (size_t p{}; p < producers; ++p) threads[p].join();
+      ch.close();
+    }
+    const auto st = ch.stats();
+
+    MpmcQueue<size_t> q{capacity};
+    atomic_size_t consumed{};
+    const auto secs = time_ms([&] {
+      vector<jthread> threads{};
+      for (size_t p{}; p < producers; ++p) {
+        threads.emplace_back([&] {
+          vector<size_t> buf(batch);
+          for (size_t i{}; i < items / producers; i += batch) {
+            span<size_t> rest{buf};
+            for (Backoff backoff{}; !rest.empty(); backoff())
+              rest = rest.subspan(q.try_push_batch(rest));
+          }
+        });
+      }
+      for (size_t c{}; c < consumers; ++c) {
+        threads.emplace_back([&] {
+          vector<size_t> buf(batch);
+          while (consumed < items) {
+            Backoff backoff{};
+            size_t n{};
+            while (!(n = q.try_pop_batch(buf)) && consumed < items) backoff();
+            consumed += n;
+          }
+        });
+      }
+    }) / 1000;
+    cout << format("{:5} {:16.0f} {:11.1f} {:8.1f} {:10} {:18.0f}\n", batch,
+                   st.items_per_sec(),
+                   chrono::duration<double, milli>(st.send_blocked).count(),
+                   chrono::duration<double, milli>(st.recv_idle).count(),
+                   st.max_depth, items / secs);
+  }
+}
+
+// Allocations and throughput of formatted messages: 2 producers format
+// items into strings or pool slots, 2 consumers format them into a buffer
+template <typename Make>
+void bench_message(string_view name, size_t items, Make make) {
+  constexpr size_t producers{2}, consumers{2};
+  using M = invoke_result_t<Make &, size_t, size_t>;
+  Channel<M> ch{64};
+  const size_t allocs{g_allocations};
+  const auto ms = time_ms([&] {
+    vector<jthread> threads{};
+    threads.reserve(producers + consumers);
+    for (size_t p{}; p < producers; ++p) {
+      threads.emplace_back([&, p] {
+        for (size_t i{}; i < items / producers; ++i) ch.send(make(p, i));
+      });
+    }
+    for (size_t c{}; c < consumers; ++c) {
+      threads.emplace_back([&, c] {
+        char out[128];
+        while (auto m = ch.recv()) {
+          string_view text{};
+          if constexpr (is_same_v<M, string>) {
+            text = *m;
+          } else {
+            text = m->view();
+          }
+          format_to_n(out, sizeof out, "cid {}: {}", c, text);
+        }
+      });
+    }
+    for (size_t p{}; p < producers; ++p) threads[p].join();
+    ch.close();
+  });
+  cout << format("{:12} {:10.0f} items/s {:8.3f} allocations/item\n", name,
+                 items / ms * 1000,
+                 static_cast<double>(g_allocations - allocs) / items);
+}
+
+void bench_messages(size_t items) {
+  cout << format("\n{} messages:\n", items);
+  bench_message("string", items, [](size_t p, size_t i) {
+    return format("pid {}, qs {}, item {:02}\n", p, 0, i + 1);
+  });
+  MessagePool slots{64 + 4};
+  bench_message("MessagePool", items, [&](size_t p, size_t i) {
+    auto m = slots.acquire();
+    m.format("pid {}, qs {}, item {:02}\n", p, 0, i + 1);
+    return m;
+  });
+}
+
+// some work that the optimizer cannot drop
+atomic_uint64_t g_sink{};
+
+void spin_work(size_t n) {
+  uint64_t h{n};
+  for (size_t i{}; i < n; ++i) h = h * 6364136223846793005u + i;
+  g_sink += h;
+}
+
+// a binary tree of tasks, every task spawns its two children
+template <typename Pool>
+void spawn_tree(Pool &pool, size_t depth, size_t work) {
+  pool.spawn([&pool, depth, work] {
+    if (depth) {
+      spawn_tree(pool, depth - 1, work);
+      spawn_tree(pool, depth - 1, work);
+    } else {
+      spin_work(work);
     }
-    cv_producer.notify_all();
+  });
+}
+
+// Tasks per second of the two pools: fine-grained tasks form a spawn tree
+// with little work per leaf, coarse-grained ones are independent and long
+void bench_pools() {
+  constexpr size_t depth{16}, coarse_tasks{2'000}, coarse_work{20'000};
+  const size_t fine_tasks{(size_t{2} << depth) - 1};
+  cout << format("\n{} fine-grained (tree) and {} coarse-grained tasks:\n",
+                 fine_tasks, coarse_tasks);
+  cout << "threads   GlobalQueue fine/s  WorkStealing fine/s   "
+          "GlobalQueue coarse/s  WorkStealing coarse/s\n";
+  const auto run = [&]<typename Pool>(size_t threads) {
+    Pool pool{threads};
+    const double fine = time_ms([&] {
+      spawn_tree(pool, depth, 10);
+      pool.wait_idle();
+    });
+    const double coarse = time_ms([&] {
+      for (size_t i{}; i < coarse_tasks; ++i)
+        pool.spawn([] { spin_work(coarse_work); });
+      pool.wait_idle();
+    });
+    return pair{fine_tasks / fine * 1000, coarse_tasks / coarse * 1000};
+  };
+  for (size_t threads : {1, 2, 4, 8}) {
+    const auto [gf, gc] = run.operator()<GlobalQueuePool>(threads);
+    const auto [wf, wc] = run.operator()<WorkStealingPool>(threads);
+    cout << format("{:7} {:20.0f} {:20.0f} {:21.0f} {:22.0f}\n", threads, gf,
+                   wf, gc, wc);
   }
 }
 
-int main() {
-  // in this paradigm, producers and consumers notify each other
-  // producers use wait while consumers use wait_for with timeout
+// CPU time and voluntary context switches of the whole process so far
+pair<chrono::microseconds, long> process_usage() {
+  rusage ru{};
+  getrusage(RUSAGE_SELF, &ru);
+  const auto us = [](timeval t) {
+    return chrono::seconds{t.tv_sec} + chrono::microseconds{t.tv_usec};
+  };
+  return {us(ru.ru_utime) + us(ru.ru_stime), ru.ru_nvcsw};
+}
+
+Task produce_async(AsyncChannel<char> &start, AsyncChannel<size_t> &ch,
+                   size_t n, atomic_size_t &left) {
+  co_await start.recv();  // returns when start is closed
+  for (size_t i{}; i < n; ++i) co_await ch.send(i);
+  if (--left == 0) ch.close();
+}
+
+Task consume_async(AsyncChannel<size_t> &ch) {
+  while (auto v = co_await ch.recv()) {
+  }
+}
+
+Task ping_async(AsyncChannel<size_t> &to, AsyncChannel<size_t> &from,
+                size_t rounds) {
+  for (size_t i{}; i < rounds; ++i) {
+    co_await to.send(i);
+    co_await from.recv();
+  }
+  to.close();
+}
+
+Task pong_async(AsyncChannel<size_t> &from, AsyncChannel<size_t> &to) {
+  while (auto v = co_await from.recv()) co_await to.send(*v);
+}
+
+// resident set size of the process in KiB
+size_t resident_kib() {
+  ifstream statm{"/proc/self/statm"};
+  size_t size{}, resident{};
+  statm >> size >> resident;
+  return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE)) / 1024;
+}
+
+// Thread-per-role against coroutines on 4 threads: many producers fan in to
+// 4 consumers. Memory per producer is the resident growth while they all
+// wait to start, plus the reserved stack or the coroutine frame
+void bench_coroutines(size_t items) {
+  constexpr size_t consumers{4}, capacity{64};
+  pthread_attr_t attr{};
+  pthread_attr_init(&attr);
+  size_t stack{};
+  pthread_attr_getstacksize(&attr, &stack);
+  pthread_attr_destroy(&attr);
+
+  cout << format("\n{} items, {} consumers, capacity {}:\n", items,
+                 consumers, capacity);
+  cout << "producers  model       items/s  RSS KiB/task  reserved B/task  "
+          "switches/item\n";
+  const auto row = [&](size_t producers, string_view model, double ms,
+                       size_t kib, size_t reserved, long csw) {
+    cout << format("{:9}  {:10} {:9.0f} {:13.1f} {:16} {:14.3f}\n",
+                   producers, model, items / ms * 1000,
+                   static_cast<double>(kib) / producers, reserved,
+                   static_cast<double>(csw) / items);
+  };
+  for (size_t producers : {10, 100, 1'000, 10'000}) {
+    if (producers <= 1'000) {
+      Channel<size_t> ch{capacity};
+      latch ready{static_cast<ptrdiff_t>(producers)}, go{1};
+      vector<jthread> threads{};
+      const size_t kib1{resident_kib()};
+      for (size_t p{}; p < producers; ++p) {
+        threads.emplace_back([&] {
+          ready.arrive_and_wait();
+          go.wait();
+          for (size_t i{}; i < items / producers; ++i) ch.send(i);
+        });
+      }
+      ready.wait();
+      const size_t kib{resident_kib() - kib1};
+      const auto [cpu1, csw1] = process_usage();
+      const double ms = time_ms([&] {
+        for (size_t c{}; c < consumers; ++c)
+          threads.emplace_back([&] {
+            while (ch.recv()) {
+            }
+          });
+        go.count_down();
+        for (size_t p{}; p < producers; ++p) threads[p].join();
+        ch.close();
+        threads.clear();
+      });
+      const auto [cpu2, csw2] = process_usage();
+      row(producers, "threads", ms, kib, stack, csw2 - csw1);
+    }
+    CoroPool pool{consumers};
+    AsyncChannel<char> start{pool, 1};
+    AsyncChannel<size_t> ch{pool, capacity};
+    atomic_size_t left{producers};
+    const size_t kib1{resident_kib()}, bytes1{Task::promise_type::frame_bytes};
+    for (size_t p{}; p < producers; ++p)
+      pool.spawn(produce_async(start, ch, items / producers, left));
+    const size_t bytes{Task::promise_type::frame_bytes - bytes1};
+    const size_t kib{resident_kib() - kib1};
+    const auto [cpu1, csw1] = process_usage();
+    const double ms = time_ms([&] {
+      for (size_t c{}; c < consumers; ++c) pool.spawn(consume_async(ch));
+      start.close();
+      pool.wait_idle();
+    });
+    const auto [cpu2, csw2] = process_usage();
+    row(producers, "coroutines", ms, kib, bytes / producers, csw2 - csw1);
+  }
+}
+
+// Cost of one handoff: two roles bounce an item over two 1-slot channels,
+// as two threads or as two coroutines on one thread
+void bench_pingpong(size_t rounds) {
+  cout << format("\n{} ping-pong rounds:\n", rounds);
+  const auto row = [&](string_view model, double ms, long csw) {
+    cout << format("{:25} {:8.0f} ns/round {:8.3f} switches/round\n", model,
+                   ms * 1e6 / rounds, static_cast<double>(csw) / rounds);
+  };
+  {
+    Channel<size_t> to{1}, from{1};
+    const auto [cpu1, csw1] = process_usage();
+    const double ms = time_ms([&] {
+      jthread pong{[&] {
+        while (auto v = to.recv()) from.send(*v);
+      }};
+      for (size_t i{}; i < rounds; ++i) {
+        to.send(i);
+        from.recv();
+      }
+      to.close();
+    });
+    const auto [cpu2, csw2] = process_usage();
+    row("threads + Channel", ms, csw2 - csw1);
+  }
+  {
+    CoroPool pool{1};
+    AsyncChannel<size_t> to{pool, 1}, from{pool, 1};
+    const auto [cpu1, csw1] = process_usage();
+    const double ms = time_ms([&] {
+      pool.spawn(pong_async(to, from));
+      pool.spawn(ping_async(to, from, rounds));
+      pool.wait_idle();
+    });
+    const auto [cpu2, csw2] = process_usage();
+    row("coroutines + AsyncChannel", ms, csw2 - csw1);
+  }
+}
+
+// Handoff latency when the next item is a few microseconds away: one
+// producer sleeps for gap and pushes a timestamp, one consumer waits for
+// it. Reports latency percentiles and the CPU time both threads used
+template <typename Q, typename Pop>
+void bench_handoff_one(string_view name, Q &q, Pop pop, size_t items,
+                       chrono::microseconds gap) {
+  using clock = chrono::steady_clock;
+  vector<float> latencies(items);
+  const auto [cpu1, csw1] = process_usage();
+  {
+    jthread consumer{[&] {
+      for (auto &l : latencies)
+        l = chrono::duration<float, micro>(clock::now() - pop(q)).count();
+    }};
+    for (size_t i{}; i < items; ++i) {
+      this_thread::sleep_for(gap);
+      q.push(clock::now());
+    }
+  }
+  const auto [cpu2, csw2] = process_usage();
+  ranges::sort(latencies);
+  const auto pct = [&](double p) {
+    return latencies[static_cast<size_t>(p / 100 * (items - 1))];
+  };
+  cout << format("{:26} {:8.1f} {:8.1f} {:8.1f} {:9.1f} {:9.0f}", name,
+                 pct(50), pct(90), pct(99), pct(99.9),
+                 chrono::duration<double, milli>(cpu2 - cpu1).count());
+}
+
+void bench_handoff(size_t items) {
+  using time_point = chrono::steady_clock::time_point;
+  for (const auto gap : {1us, 50us}) {
+    cout << format("\n{} handoffs, producer sleeps {}us between them:\n",
+                   items, gap.count());
+    cout << "queue                       p50 us   p90 us   p99 us  p99.9 us"
+            "    cpu ms\n";
+    {
+      LockedQueue<time_point> q{1024};
+      bench_handoff_one(
+          "LockedQueue", q, [](auto &q) { return *q.pop_for(1s); }, items,
+          gap);
+      cout << "\n";
+    }
+    {
+      MpmcQueue<time_point> q{1024};
+      bench_handoff_one(
+          "MpmcQueue + Backoff", q, [](auto &q) { return *q.pop_for(1s); },
+          items, gap);
+      cout << "\n";
+    }
+    for (const auto &[mode, name] :
+         {pair{WaitMode::low_latency, "ParkingQueue low_latency"},
+          pair{WaitMode::power_saving, "ParkingQueue power_saving"}}) {
+      ParkingQueue<time_point> q{1024, mode};
+      bench_handoff_one(
+          name, q, [](auto &q) { return q.pop(); }, items, gap);
+      cout << format("  spin budget {}\n", q.pop_spin_budget());
+    }
+  }
+}
+
+// Idle consumers and shutdown: consumers wait on an empty queue for idle,
+// then are told to stop. Reports the CPU time and wakeups spent while idle
+// and how long the stop took
+template <typename Wait, typename Stop>
+void bench_idle(string_view name, size_t consumers, Wait wait, Stop stop) {
+  constexpr auto idle{500ms};
+  vector<jthread> threads{};
+  for (size_t c{}; c < consumers; ++c) threads.emplace_back(wait);
+  this_thread::sleep_for(10ms);
+  const auto [cpu1, csw1] = process_usage();
+  this_thread::sleep_for(idle);
+  const auto [cpu2, csw2] = process_usage();
+  const auto t1 = chrono::steady_clock::now();
+  stop();
+  threads.clear();
+  const chrono::duration<double, milli> shutdown{chrono::steady_clock::now() -
+                                                 t1};
+  cout << format("{:24} cpu {:6} us  wakeups {:6}  shutdown {:7.2f} ms\n",
+                 name, (cpu2 - cpu1).count(), csw2 - csw1, shutdown.count());
+}
+
+void bench_shutdown(size_t consumers) {
+  cout << format("\n{} consumers idle for 500ms, then shut down:\n",
+                 consumers);
+  {
+    // the original scheme: poll a flag between timed waits
+    LockedQueue<int> q{queue_limit};
+    atomic_bool done{};
+    bench_idle(
+        "LockedQueue + flag", consumers,
+        [&] {
+          while (!done) q.pop_for(consumer_wait);
+        },
+        [&] { done = true; });
+  }
+  {
+    MpmcQueue<int> q{queue_limit};
+    atomic_bool done{};
+    bench_idle(
+        "MpmcQueue + flag", consumers,
+        [&] {
+          while (!done) q.pop_for(consumer_wait);
+        },
+        [&] { done = true; });
+  }
+  {
+    Channel<int> ch{queue_limit};
+    bench_idle(
+        "Channel::close", consumers,
+        [&] {
+          while (ch.recv()) {
+          }
+        },
+        [&] { ch.close(); });
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // producers block while the channel is full, consumers while it is
+  // empty, closing the channel ends the consumers once it is drained
   list<future<void>> producers;
   list<future<void>> consumers;
   for (size_t i{}; i < num_producers; ++i)
@@ -54,8 +1547,40 @@ int main() {
     consumers.emplace_back(async(consumer, i));
 
   for (auto &f : producers) f.wait();
-  production_complete = true;
+  qs.close();
   cout << "producers done.\n";
   for (auto &f : consumers) f.wait();
   cout << "consumers done.\n";
+  const auto st = qs.stats();
+  cout << format(
+      "{} items, max depth {}, producers blocked {:.0f} ms, consumers idle "
+      "{:.0f} ms\n",
+      st.received, st.max_depth,
+      chrono::duration<double, milli>(st.send_blocked).count(),
+      chrono::duration<double, milli>(st.recv_idle).count());
+
+  // the benchmarks only run on request, e.g. --bench 100000 items, the
+  // batch, message and coroutine runs use four times as many
+  if (argc < 2 || argv[1] != "--bench"sv) return 0;
+  const size_t bench_items{argc > 2 ? stoull(argv[2]) : 100'000};
+  using time_point = chrono::steady_clock::time_point;
+  cout << format("\n{} items through a 1024-slot queue:\n", bench_items);
+  cout << "producers consumers  LockedQueue items/s   p99  "
+          "MpmcQueue items/s   p99\n";
+  for (size_t p : {1, 4, 16, 32}) {
+    for (size_t c : {1, 4, 16, 32}) {
+      auto [lr, ll] = bench_queue<LockedQueue<time_point>>(p, c, bench_items);
+      auto [mr, ml] = bench_queue<MpmcQueue<time_point>>(p, c, bench_items);
+      cout << format("{:9} {:9} {:19.0f} {:6.0f}us {:17.0f} {:6.0f}us\n", p,
+                     c, lr, ll, mr, ml);
+    }
+  }
+
+  bench_batch(4 * bench_items);
+  bench_messages(4 * bench_items);
+  bench_pools();
+  bench_coroutines(4 * bench_items);
+  bench_pingpong(bench_items);
+  bench_handoff(bench_items / 5);
+  bench_shutdown(16);
 }
@@ -1,8 +1,461 @@
+// Build: -O3 -march=native lets the lane loops of error_stats use the
+// widest vectors, -ffast-math must not be used, it removes the Kahan terms
 #include <bits/stdc++.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 using namespace std;
 
-int main() {
+// squared error of one sample pair, works for mixed types like double/int
+template <typename T, typename U>
+double sq_err(T a, U b) {
+  const double d{static_cast<double>(a) - static_cast<double>(b)};
+  return d * d;
+}
+
+// Accumulated error without last, in one pass: writes the error sum of the
+// first k pairs for every k in [0, n) and returns the end of the output. The
+// sums are added in the same order as inner_product over each prefix, so the
+// results are identical, only O(n) instead of O(n^2). A long series can be
+// fed in pieces by passing the error so far as acc
+template <typename It1, typename It2, typename Out>
+Out accumulated_error(It1 first1, It1 last1, It2 first2, Out out,
+                      double acc = 0.0) {
+  for (; first1 != last1; ++first1, ++first2) {
+    *out++ = acc;
+    acc += sq_err(*first1, *first2);
+  }
+  return out;
+}
+
+// Streaming mode: samples are added as they arrive and the running error is
+// available after every step
+class ErrorAccumulator {
+ public:
+  // returns the error sum including this pair
+  template <typename T, typename U>
+  double add(T a, U b) {
+    ++count_;
+    return sum_ += sq_err(a, b);
+  }
+
+  double sum() const { return sum_; }
+  size_t count() const { return count_; }
+  double mse() const { return count_ ? sum_ / count_ : 0.0; }
+
+ private:
+  double sum_{};
+  size_t count_{};
+};
+
+enum class Summation { pairwise, kahan };
+
+// sums of squared and absolute errors of n sample pairs
+struct ErrorStats {
+  double sse{};
+  double sae{};
+  size_t n{};
+
+  double mse() const { return n ? sse / n : 0.0; }
+  double mae() const { return n ? sae / n : 0.0; }
+
+  ErrorStats &operator+=(const ErrorStats &o) {
+    sse += o.sse;
+    sae += o.sae;
+    n += o.n;
+    return *this;
+  }
+};
+
+constexpr size_t err_lanes{8};
+constexpr size_t err_block{4096};
+
+// One block of at most err_block pairs. Every lane sums every err_lanes-th
+// pair, so the inner loop has no dependency between lanes and vectorizes.
+// With kahan each lane keeps its own compensation term
+template <typename T, typename U>
+ErrorStats error_block(const T *a, const U *b, size_t n, Summation s) {
+  double sq[err_lanes]{}, ab[err_lanes]{};
+  double sq_c[err_lanes]{}, ab_c[err_lanes]{};
+  const auto kahan_add = [](double &sum, double &c, double x) {
+    const double y{x - c}, t{sum + y};
+    c = (t - sum) - y;
+    sum = t;
+  };
+  const size_t body{n - n % err_lanes};
+  if (s == Summation::kahan) {
+    for (size_t i{}; i < body; i += err_lanes) {
+      for (size_t j{}; j < err_lanes; ++j) {
+        const double d{static_cast<double>(a[i + j]) -
+                       static_cast<double>(b[i + j])};
+        kahan_add(sq[j], sq_c[j], d * d);
+        kahan_add(ab[j], ab_c[j], abs(d));
+      }
+    }
+  } else {
+    for (size_t i{}; i < body; i += err_lanes) {
+      for (size_t j{}; j < err_lanes; ++j) {
+        const double d{static_cast<double>(a[i + j]) -
+                       static_cast<double>(b[i + j])};
+        sq[j] += d * d;
+        ab[j] += abs(d);
+      }
+    }
+  }
+  // the tail fills the first lanes once, the same way as the body
+  for (size_t i{body}, j{}; i < n; ++i, ++j) {
+    const double d{static_cast<double>(a[i]) - static_cast<double>(b[i])};
+    if (s == Summation::kahan) {
+      kahan_add(sq[j], sq_c[j], d * d);
+      kahan_add(ab[j], ab_c[j], abs(d));
+    } else {
+      sq[j] += d * d;
+      ab[j] += abs(d);
+    }
+  }
+  // the compensation holds the negated lost low bits, then lanes pairwise
+  for (size_t j{}; j < err_lanes; ++j) {
+    sq[j] -= sq_c[j];
+    ab[j] -= ab_c[j];
+  }
+  for (size_t w{err_lanes / 2}; w; w /= 2) {
+    for (size_t j{}; j < w; ++j) {
+      sq[j] += sq[j + w];
+      ab[j] += ab[j + w];
+    }
+  }
+  return {sq[0], ab[0], n};
+}
+
+// Squared and absolute error of a and b, e.g. predictions against
+// quantized values, on up to threads threads. The input is cut into blocks
+// of err_block pairs whatever the thread count, each block is reduced on
+// its own and the block sums are added as a pairwise tree, so the result is
+// the same bits for any number of threads and the rounding error grows with
+// log(n) rather than n
+template <typename T, typename U>
+ErrorStats error_stats(span<const T> a, span<const U> b,
+                       Summation s = Summation::pairwise,
+                       size_t threads = thread::hardware_concurrency()) {
+  const size_t n{min(a.size(), b.size())};
+  const size_t blocks{(n + err_block - 1) / err_block};
+  if (!blocks) return {};
+  vector<ErrorStats> partial(blocks);
+  threads = clamp<size_t>(threads, 1, blocks);
+  // each thread takes a contiguous range of blocks
+  const auto work = [&](size_t t) {
+    for (size_t k{blocks * t / threads}; k < blocks * (t + 1) / threads; ++k) {
+      const size_t first{k * err_block};
+      partial[k] = error_block(a.data() + first, b.data() + first,
+                               min(err_block, n - first), s);
+    }
+  };
+  {
+    vector<jthread> workers{};
+    for (size_t t{1}; t < threads; ++t) workers.emplace_back(work, t);
+    work(0);
+  }
+  for (size_t w{1}; w < blocks; w *= 2)
+    for (size_t k{}; k + w < blocks; k += 2 * w) partial[k] += partial[k + w];
+  return partial[0];
+}
+
+// Read-only mapping of a file of raw samples of type T, e.g. one column of
+// a prediction log. The pages are only read in when a pass touches them
+template <typename T>
+class MappedColumn {
+ public:
+  // nullopt if the file is missing or not a whole number of samples
+  static optional<MappedColumn> open(const filesystem::path &path) {
+    const int fd{::open(path.c_str(), O_RDONLY)};
+    if (fd < 0) return {};
+    struct stat st {};
+    void *base{MAP_FAILED};
+    if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+        size_t(st.st_size) % sizeof(T) == 0)
+      base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps the file referenced
+    ::close(fd);
+    if (base == MAP_FAILED) return {};
+    return MappedColumn{static_cast<const T *>(base),
+                        size_t(st.st_size) / sizeof(T)};
+  }
+
+  MappedColumn(MappedColumn &&o) noexcept
+      : data_{exchange(o.data_, nullptr)}, size_{o.size_} {}
+  MappedColumn &operator=(MappedColumn &&o) noexcept {
+    swap(data_, o.data_);
+    swap(size_, o.size_);
+    return *this;
+  }
+  ~MappedColumn() {
+    if (data_) munmap(const_cast<T *>(data_), size_ * sizeof(T));
+  }
+
+  span<const T> samples() const { return {data_, size_}; }
+
+  // hints for the samples [first, first + n): read them ahead, or drop them
+  // from this mapping once they were used
+  void will_need(size_t first, size_t n) const {
+    advise_(first, n, MADV_WILLNEED);
+  }
+  void done_with(size_t first, size_t n) const {
+    advise_(first, n, MADV_DONTNEED);
+  }
+
+ private:
+  MappedColumn(const T *data, size_t size) : data_{data}, size_{size} {
+    advise_(0, size_, MADV_SEQUENTIAL);
+  }
+
+  // madvise wants page aligned ranges, so the range is widened to pages
+  void advise_(size_t first, size_t n, int advice) const {
+    static const size_t page{static_cast<size_t>(sysconf(_SC_PAGESIZE))};
+    n = min(n, size_ - min(first, size_));
+    if (!n) return;
+    const auto begin =
+        reinterpret_cast<uintptr_t>(data_ + first) / page * page;
+    const auto end = reinterpret_cast<uintptr_t>(data_ + first + n);
+    madvise(reinterpret_cast<void *>(begin), end - begin, advice);
+  }
+
+  const T *data_;
+  size_t size_;
+};
+
+// Error metrics of two mapped columns in one streaming pass. The columns
+// are walked in windows of window pairs: the next window is prefetched
+// while error_stats reduces the current one on threads threads, and the
+// pages of a finished window are dropped. If on_series is given, it gets
+// the accumulated error without last of each window in order
+template <typename T, typename U>
+ErrorStats stream_error_stats(
+    const MappedColumn<T> &a, const MappedColumn<U> &b,
+    size_t window = size_t{1} << 22, bool prefetch = true,
+    size_t threads = thread::hardware_concurrency(),
+    const function<void(span<const double>)> &on_series = {}) {
+  const span<const T> as{a.samples()};
+  const span<const U> bs{b.samples()};
+  const size_t n{min(as.size(), bs.size())};
+  // whole blocks, so that windows do not change how error_stats adds up
+  window = max(window / err_block, size_t{1}) * err_block;
+  ErrorStats total{};
+  vector<double> series(on_series ? min(window, n) : 0);
+  double acc{};
+  for (size_t first{}; first < n; first += window) {
+    const size_t len{min(window, n - first)};
+    if (prefetch) {
+      a.will_need(first + window, window);
+      b.will_need(first + window, window);
+    }
+    total += error_stats(as.subspan(first, len), bs.subspan(first, len),
+                         Summation::pairwise, threads);
+    if (on_series) {
+      accumulated_error(as.begin() + first, as.begin() + first + len,
+                        bs.begin() + first, series.begin(), acc);
+      acc = series[len - 1] + sq_err(as[first + len - 1], bs[first + len - 1]);
+      on_series({series.data(), len});
+    }
+    a.done_with(first, len);
+    b.done_with(first, len);
+  }
+  return total;
+}
+
+template <typename F>
+double time_ms(F &&f) {
+  auto t1 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t1)
+      .count();
+}
+
+// the original loop: one inner_product per prefix
+vector<double> accumulated_error_quadratic(const vector<double> &ds,
+                                           const vector<int> &is) {
+  vector<double> out{};
+  out.reserve(ds.size());
+  for (auto it{ds.begin()}; it != ds.end(); ++it)
+    out.push_back(
+        inner_product(ds.begin(), it, is.begin(), 0.0, std::plus<double>(),
+                      [](double a, double b) { return pow(a - b, 2); }));
+  return out;
+}
+
+// the per-prefix inner_product loop against the one-pass series and the
+// streaming accumulator, the quadratic loop is skipped for large n
+void bench_accumulated(unsigned seed) {
+  cout << "\n       n  inner_product ms  one-pass ms  streaming ms  "
+          "max diff\n";
+  mt19937 rng{seed};
+  normal_distribution<double> noise{0.0, 2.0};
+  for (size_t n : {1'000, 10'000, 50'000, 1'000'000, 10'000'000}) {
+    vector<double> ds(n);
+    vector<int> is(n);
+    for (size_t i{}; i < n; ++i) {
+      ds[i] = 5.0 * sin(i * 2 * numbers::pi / 100) + noise(rng);
+      is[i] = static_cast<int>(ds[i]);
+    }
+    vector<double> fast(n), slow{};
+    string quad{"-"};
+    if (n <= 50'000)
+      quad = format("{:.2f}", time_ms([&] {
+                      slow = accumulated_error_quadratic(ds, is);
+                    }));
+    const double one_pass = time_ms([&] {
+      accumulated_error(ds.begin(), ds.end(), is.begin(), fast.begin());
+    });
+    double last{};
+    const double streaming = time_ms([&] {
+      ErrorAccumulator acc{};
+      for (size_t i{}; i < n; ++i) last = acc.add(ds[i], is[i]);
+    });
+    // the last running error is the series' last value plus the last pair
+    double diff{abs(last - (fast.back() + sq_err(ds.back(), is.back())))};
+    for (size_t i{}; i < slow.size(); ++i)
+      diff = max(diff, abs(slow[i] - fast[i]));
+    cout << format("{:8} {:>17} {:12.2f} {:13.2f} {:9.3g}\n", n, quad,
+                   one_pass, streaming, diff);
+  }
+}
+
+// The inner_product + pow expression of main() against error_stats on
+// n pairs of double predictions and int values. The reference error is
+// summed in long double
+void bench_error_stats(size_t n, unsigned seed) {
+  vector<double> ds(n);
+  vector<int> is(n);
+  mt19937 rng{seed};
+  normal_distribution<double> noise{0.0, 2.0};
+  for (size_t i{}; i < n; ++i) {
+    ds[i] = 1e3 * sin(i * 2 * numbers::pi / 1000) + noise(rng);
+    is[i] = static_cast<int>(ds[i]);
+  }
+  long double ref{};
+  for (size_t i{}; i < n; ++i) {
+    const long double d{ds[i] - static_cast<long double>(is[i])};
+    ref += d * d;
+  }
+  const double gb{n * (sizeof(double) + sizeof(int)) / 1e9};
+  cout << format("\n{} pairs, squared error sum:\n", n);
+  cout << "method                 threads        ms    GB/s  "
+          "sse                     rel error\n";
+  const auto row = [&](string_view name, size_t threads, double ms,
+                       double sse) {
+    cout << format("{:22} {:7} {:9.1f} {:7.2f}  {:<23.17g} {:9.2e}\n", name,
+                   threads, ms, gb / ms * 1000, sse,
+                   static_cast<double>(abs(sse - ref) / ref));
+  };
+  double sse{};
+  double ms = time_ms([&] {
+    sse = inner_product(ds.begin(), ds.end(), is.begin(), 0.0,
+                        std::plus<double>(),
+                        [](double a, double b) { return pow(a - b, 2); });
+  });
+  row("inner_product + pow", 1, ms, sse);
+  for (const auto &[mode, name] :
+       {pair{Summation::pairwise, "error_stats pairwise"},
+        pair{Summation::kahan, "error_stats kahan"}}) {
+    for (size_t threads : {1, 2, 4, 8}) {
+      ErrorStats st{};
+      ms = time_ms([&] {
+        st = error_stats(span<const double>{ds}, span<const int>{is}, mode,
+                         threads);
+      });
+      row(name, threads, ms, st.sse);
+    }
+  }
+}
+
+// flushes a file and evicts it from the page cache
+void drop_cached(const filesystem::path &path) {
+  const int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd < 0) return;
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+  ::close(fd);
+}
+
+// writes the samples as a raw column file, evicted from the page cache so
+// that the next pass has to read it from disk
+template <typename T>
+void write_column(const filesystem::path &path, span<const T> samples) {
+  {
+    ofstream out{path, ios::binary | ios::trunc};
+    out.write(reinterpret_cast<const char *>(samples.data()),
+              samples.size_bytes());
+  }
+  drop_cached(path);
+}
+
+// stream_error_stats over two column files against error_stats on the same
+// samples in memory. Cold passes start with the files evicted from the page
+// cache
+void bench_stream(size_t n, unsigned seed) {
+  const auto dir = filesystem::temp_directory_path();
+  const auto dpath = dir / "ch10p3errsum_ds.bin";
+  const auto ipath = dir / "ch10p3errsum_is.bin";
+  ErrorStats in_memory{};
+  {
+    vector<double> ds(n);
+    vector<int> is(n);
+    mt19937 rng{seed};
+    normal_distribution<double> noise{0.0, 2.0};
+    for (size_t i{}; i < n; ++i) {
+      ds[i] = 1e3 * sin(i * 2 * numbers::pi / 1000) + noise(rng);
+      is[i] = static_cast<int>(ds[i]);
+    }
+    const double ms = time_ms([&] {
+      in_memory = error_stats(span<const double>{ds}, span<const int>{is});
+    });
+    write_column(dpath, span<const double>{ds});
+    write_column(ipath, span<const int>{is});
+    cout << format("\n{} pairs ({:.2f} GB) from column files:\n", n,
+                   n * (sizeof(double) + sizeof(int)) / 1e9);
+    cout << "pass                            ms     GB/s  sse\n";
+    cout << format("{:26} {:8.1f} {:8.2f}  {:.17g}\n", "in memory", ms,
+                   n * (sizeof(double) + sizeof(int)) / ms / 1e6,
+                   in_memory.sse);
+  }
+  auto ds = MappedColumn<double>::open(dpath);
+  auto is = MappedColumn<int>::open(ipath);
+  if (!ds || !is) {
+    cout << "cannot map the column files\n";
+    return;
+  }
+  const auto pass = [&](string_view name, bool cold, bool prefetch,
+                        bool series) {
+    if (cold) {
+      drop_cached(dpath);
+      drop_cached(ipath);
+    }
+    double last{};
+    ErrorStats st{};
+    const double ms = time_ms([&] {
+      st = stream_error_stats(
+          *ds, *is, size_t{1} << 22, prefetch, thread::hardware_concurrency(),
+          series ? [&](span<const double> s) { last = s.back(); }
+                 : function<void(span<const double>)>{});
+    });
+    cout << format("{:26} {:8.1f} {:8.2f}  {:.17g}", name, ms,
+                   st.n * (sizeof(double) + sizeof(int)) / ms / 1e6, st.sse);
+    if (series) cout << format(" (series ends at {:.17g})", last);
+    cout << "\n";
+  };
+  pass("mapped, cold", true, false, false);
+  pass("mapped, cold, prefetch", true, true, false);
+  pass("mapped, warm, prefetch", false, true, false);
+  pass("mapped, cold, + series", true, true, true);
+  ds.reset();
+  is.reset();
+  filesystem::remove(dpath);
+  filesystem::remove(ipath);
+}
+
+int main(int argc, char *argv[]) {
   constexpr size_t vlen{100};
   vector<double> ds(vlen);
   vector<int> is(vlen);
@@ -24,14 +477,31 @@ int main() {
   double errsum =
       inner_product(ds.begin(), ds.end(), is.begin(), 0.0, std::plus<double>(),
                     [](double a, double b) { return pow(a - b, 2); });
-  cout << format("error sum: {:.3f}\n\n", errsum);
+  cout << format("error sum: {:.3f}\n", errsum);
+  const auto st = error_stats(span<const double>{ds}, span<const int>{is});
+  cout << format("error_stats: sse {:.3f}, mse {:.4f}, mae {:.4f}\n\n",
+                 st.sse, st.mse(), st.mae());
 
+  // one pass instead of an inner_product per prefix
   cout << "accumulated error without last:\n";
-  for (auto it{ds.begin()}; it != ds.end(); ++it) {
-    double accumsum =
-        inner_product(ds.begin(), it, is.begin(), 0.0, std::plus<double>(),
-                      [](double a, double b) { return pow(a - b, 2); });
-    cout << format("{:-5.2f} ", accumsum);
-  }
+  vector<double> accum(vlen);
+  accumulated_error(ds.begin(), ds.end(), is.begin(), accum.begin());
+  for (const auto &v : accum) cout << format("{:-5.2f} ", v);
   cout << '\n';
+
+  cout << "\nstreaming, running error every 10 samples:\n";
+  ErrorAccumulator acc{};
+  for (size_t i{}; i < vlen; ++i) {
+    const double e{acc.add(ds[i], is[i])};
+    if ((i + 1) % 10 == 0) cout << format("{:-5.2f} ", e);
+  }
+  cout << format("\nmse: {:.4f}\n", acc.mse());
+
+  // the benchmarks only run on request, e.g. --bench 100000000 samples, they
+  // need about 12 bytes of memory and of temporary files per sample
+  if (argc < 2 || argv[1] != "--bench"sv) return 0;
+  const size_t n{argc > 2 ? stoull(argv[2]) : 100'000'000};
+  bench_accumulated(42);
+  bench_error_stats(n, 42);
+  bench_stream(n, 42);
 }
@@ -1,12 +1,442 @@
 #include <bits/stdc++.h>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
+// counts every allocation, to show that slices allocate nothing
+atomic_size_t g_allocations{};
+
+constexpr align_val_t malloc_align{alignof(max_align_t)};
+
+// the single place every operator new counts in, nothrow forms included;
+// counted_alloc returns nullptr and counted_new throws
+[[gnu::noinline]] void *counted_alloc(size_t n, align_val_t align) noexcept {
+  const size_t a{static_cast<size_t>(align)};
+  n = max(n, size_t{1});
+  void *p{a <= alignof(max_align_t) ? malloc(n)
+                                     : aligned_alloc(a, (n + a - 1) / a * a)};
+  if (p) ++g_allocations;
+  return p;
+}
+[[gnu::noinline]] void counted_free(void *p) noexcept {
+  free(p);
+}
+
+void *counted_new(size_t n, align_val_t a) {
+  if (void *p = counted_alloc(n, a)) return p;
+  throw bad_alloc{};
+}
+
+void *operator new(size_t n) { return counted_new(n, malloc_align); }
+void *operator new[](size_t n) { return counted_new(n, malloc_align); }
+void *operator new(size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new[](size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new(size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new[](size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new(size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void *operator new[](size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, size_t) noexcept { counted_free(p); }
+void operator delete(void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete[](void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, const nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+
+constexpr auto eq = [](const auto &el, const auto &sep) { return el == sep; };
+
+// [b, e) as a view into the source: string_view for chars, span for other
+// contiguous ranges and a subrange otherwise
+template <typename It>
+auto make_slice(It b, It e) {
+  using T = iter_value_t<It>;
+  const auto n = static_cast<size_t>(ranges::distance(b, e));
+  if constexpr (contiguous_iterator<It> && is_same_v<T, char>) {
+    return string_view{to_address(b), n};
+  } else if constexpr (contiguous_iterator<It>) {
+    return span<const T>{to_address(b), n};
+  } else {
+    return ranges::subrange<It>{b, e};
+  }
+}
+
+// Finds every c in [p, end) in order. Blocks of 32 bytes (AVX2) or 16
+// bytes (SSE2 or plain code) are compared at once and the matches of the
+// current block are kept as a movemask, so a block holding several
+// separators is only compared once
+class CharScanner {
+ public:
+#if defined(__AVX2__)
+  static constexpr size_t width{32};
+#else
+  static constexpr size_t width{16};
+#endif
+
+  CharScanner() = default;
+  CharScanner(const char *p, const char *end, char c)
+      : block_{p}, end_{end}, c_{c}, bits_{mask_(p)} {}
+
+  // the next match, or end
+  const char *next() {
+    while (!bits_) {
+      if (size_t(end_ - block_) <= width) return end_;
+      block_ += width;
+      bits_ = mask_(block_);
+    }
+    const char *p{block_ + countr_zero(bits_)};
+    bits_ &= bits_ - 1;
+    return p;
+  }
+
+ private:
+  uint32_t mask_(const char *p) const {
+    const size_t n{min<size_t>(end_ - p, width)};
+    if (n == width) {
+#if defined(__AVX2__)
+      return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)),
+          _mm256_set1_epi8(c_))));
+#elif defined(__SSE2__)
+      return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)),
+          _mm_set1_epi8(c_))));
+#endif
+    }
+    uint32_t bits{};
+    for (size_t i{}; i < n; ++i) bits |= uint32_t{p[i] == c_} << i;
+    return bits;
+  }
+
+  const char *block_{};
+  const char *end_{};
+  char c_{};
+  uint32_t bits_{};
+};
+
+// first c in [p, end), or end
+inline const char *find_char(const char *p, const char *end, char c) {
+  return CharScanner{p, end, c}.next();
+}
+
+// first occurrence of sep in [p, end), or end: candidates are found by
+// their first byte and the rest is compared
+inline const char *find_sep(const char *p, const char *end, string_view sep) {
+  if (sep.empty() || size_t(end - p) < sep.size()) return end;
+  const char *last{end - sep.size() + 1};
+  for (; (p = find_char(p, last, sep[0])) != last; ++p)
+    if (!memcmp(p + 1, sep.data() + 1, sep.size() - 1)) return p;
+  return end;
+}
+
+// Lazy split: the slices split() would produce, found one at a time as the
+// range is iterated. Every slice points into the source, so nothing is
+// copied or allocated and the source has to outlive the slices. Contiguous
+// chars split by eq on a char are scanned with a CharScanner, and by eq on
+// a string separator they split on the whole string. Any other predicate
+// is called for every element
+template <typename It, typename V, typename Pred>
+class SplitRange {
+  static constexpr bool contiguous_chars_{
+      contiguous_iterator<It> && is_same_v<iter_value_t<It>, char>};
+  // eq is const, a Pred deduced from it by value is not
+  static constexpr bool default_pred_{
+      is_same_v<remove_cv_t<Pred>, remove_cv_t<decltype(eq)>>};
+  static constexpr bool fast_char_{contiguous_chars_ && default_pred_ &&
+                                   is_same_v<V, char>};
+  static constexpr bool multi_byte_{contiguous_chars_ && default_pred_ &&
+                                    is_convertible_v<const V &, string_view>};
+
+ public:
+  class iterator {
+   public:
+    using value_type = decltype(make_slice(declval<It>(), declval<It>()));
+    using difference_type = ptrdiff_t;
+
+    iterator() = default;
+    explicit iterator(const SplitRange *r) : r_{r}, cur_{r->it_} {
+      done_ = cur_ == r_->end_it_;
+      if constexpr (fast_char_)
+        scanner_ = {to_address(cur_), to_address(r_->end_it_), r_->sep_};
+      find_();
+    }
+
+    value_type operator*() const { return make_slice(cur_, next_); }
+    iterator &operator++() {
+      // a separator at the very end does not start another slice
+      if (next_ == r_->end_it_ ||
+          (next_ = ranges::next(next_, r_->sep_size_())) == r_->end_it_) {
+        done_ = true;
+      } else {
+        cur_ = next_;
+        find_();
+      }
+      return *this;
+    }
+    iterator operator++(int) {
+      auto old{*this};
+      ++*this;
+      return old;
+    }
+    bool operator==(default_sentinel_t) const { return done_; }
+    bool operator==(const iterator &o) const {
+      return done_ == o.done_ && (done_ || cur_ == o.cur_);
+    }
+
+   private:
+    void find_() {
+      // slices are found in order, so the scanner's next match is the
+      // first one at or after cur_
+      if constexpr (fast_char_) {
+        next_ = cur_ + (scanner_.next() - to_address(cur_));
+      } else if constexpr (multi_byte_) {
+        const char *p{to_address(cur_)};
+        next_ = cur_ + (find_sep(p, to_address(r_->end_it_), r_->sep_) - p);
+      } else {
+        next_ = find_if(cur_, r_->end_it_,
+                        [&](const auto &el) { return r_->f_(el, r_->sep_); });
+      }
+    }
+
+    const SplitRange *r_{};
+    It cur_{};
+    It next_{};  // the separator that ends the slice, or end_it
+    bool done_{true};
+    [[no_unique_address]] conditional_t<fast_char_, CharScanner, monostate>
+        scanner_{};
+  };
+
+  SplitRange(It it, It end_it, V sep, Pred f)
+      : it_{it}, end_it_{end_it}, sep_{move(sep)}, f_{move(f)} {}
+
+  iterator begin() const { return iterator{this}; }
+  default_sentinel_t end() const { return {}; }
+
+ private:
+  ptrdiff_t sep_size_() const {
+    if constexpr (multi_byte_) {
+      return max<ptrdiff_t>(string_view{sep_}.size(), 1);
+    } else {
+      return 1;
+    }
+  }
+
+  It it_;
+  It end_it_;
+  V sep_;
+  Pred f_;
+};
+
+template <typename It, typename V, typename Pred = decltype(eq)>
+SplitRange<It, V, Pred> slices(It it, It end_it, const V &sep, Pred f = eq) {
+  return {it, end_it, sep, f};
+}
+
+template <typename In, typename V>
+auto strslices(const In &str, const V &sep) {
+  return slices(str.begin(), str.end(), sep);
+}
+
+// Split output in compressed sparse row form: the elements of all slices in
+// one buffer and where each slice begins in an offsets array, so n slices
+// cost two growing vectors instead of n allocations, and reading them walks
+// memory in order. Slice i is a string_view for chars and a span otherwise
+template <typename T>
+class FlatSlices {
+ public:
+  using slice_type =
+      conditional_t<is_same_v<T, char>, string_view, span<const T>>;
+
+  class iterator {
+   public:
+    using value_type = slice_type;
+    using difference_type = ptrdiff_t;
+
+    iterator() = default;
+    iterator(const FlatSlices *f, size_t i) : f_{f}, i_{i} {}
+
+    value_type operator*() const { return (*f_)[i_]; }
+    iterator &operator++() {
+      ++i_;
+      return *this;
+    }
+    iterator operator++(int) { return {f_, i_++}; }
+    bool operator==(const iterator &o) const { return i_ == o.i_; }
+
+   private:
+    const FlatSlices *f_{};
+    size_t i_{};
+  };
+
+  template <typename It>
+  void emplace_back(It b, It e) {
+    data_.insert(data_.end(), b, e);
+    offsets_.push_back(data_.size());
+  }
+
+  // room for n more elements, growing at least geometrically so that
+  // reserving before every small split stays amortized O(1)
+  void reserve_elements(size_t n) {
+    if (data_.size() + n > data_.capacity())
+      data_.reserve(max(data_.size() + n, 2 * data_.capacity()));
+  }
+
+  slice_type operator[](size_t i) const {
+    return {data_.data() + offsets_[i], offsets_[i + 1] - offsets_[i]};
+  }
+
+  size_t size() const { return offsets_.size() - 1; }
+  bool empty() const { return size() == 0; }
+  iterator begin() const { return {this, 0}; }
+  iterator end() const { return {this, size()}; }
+
+  void clear() {
+    data_.clear();
+    offsets_.resize(1);
+  }
+
+ private:
+  vector<T> data_{};
+  vector<size_t> offsets_{0};
+};
+
+// Copies every slice into dest, one construction per slice. Empty slices
+// between two separators are kept, a trailing separator adds none. A
+// FlatSlices dest reserves room for the whole input first
 template <typename It, typename Oc, typename V, typename Pred>
 It split(It it, It end_it, Oc &dest, const V &sep, Pred &f) {
+  if constexpr (requires { dest.reserve_elements(size_t{}); } &&
+                sized_sentinel_for<It, It>)
+    dest.reserve_elements(static_cast<size_t>(end_it - it));
+  for (auto s : slices(it, end_it, sep, f))
+    dest.emplace_back(s.begin(), s.end());
+  return end_it;
+};
+
+template <typename It, typename Oc, typename V>
+It split(It it, const It end_it, Oc &dest, const V &sep) {
+  return split(it, end_it, dest, sep, eq);
+}
+
+template <typename In, typename Out, typename V>
+Out &strsplit(const In &str, Out &dest, const V &sep) {
+  split(str.begin(), str.end(), dest, sep, eq);
+  return dest;
+}
+
+// Splits a large buffer on threads threads. Chunk k starts right after
+// the first separator at or after k * size / threads, so every chunk ends
+// with a separator and no slice crosses two chunks. Slicing a chunk then
+// follows the same rules as slicing the whole text. Every chunk counts its
+// slices, a prefix sum of the counts sizes the output once and tells each
+// chunk where its slices go, and the chunks then write their own ranges.
+// Each thread gets at least parallel_split_min bytes, a smaller text is
+// split serially
+constexpr size_t parallel_split_min{1 << 20};
+
+template <typename V>
+vector<string_view> parallel_split(string_view text, const V &sep,
+                                   size_t threads) {
+  threads = clamp<size_t>(text.size() / parallel_split_min, 1,
+                          max<size_t>(threads, 1));
+  vector<string_view> out{};
+  if (threads == 1) {
+    for (string_view s : slices(text.begin(), text.end(), sep))
+      out.push_back(s);
+    return out;
+  }
+  const char *data{text.data()}, *end{text.data() + text.size()};
+  // the separator at or after pos, as an offset, and its size
+  const auto find = [&](size_t pos) -> pair<size_t, size_t> {
+    if constexpr (is_same_v<V, char>) {
+      return {find_char(data + pos, end, sep) - data, 1};
+    } else {
+      const string_view s{sep};
+      // a match that overlaps one starting just before it, like the middle
+      // of "aaa" for "aa", is not where a scan from the start would cut
+      for (size_t at{}; (at = find_sep(data + pos, end, s) - data) <
+                        text.size();
+           pos = at + 1) {
+        const size_t back{min(at, s.size() - 1)};
+        if (find_sep(data + at - back, data + at + s.size() - 1, s) ==
+            data + at + s.size() - 1)
+          return {at, s.size()};
+      }
+      return {text.size(), s.size()};
+    }
+  };
+  vector<size_t> starts(threads + 1, text.size());
+  starts[0] = 0;
+  for (size_t t{1}; t < threads; ++t) {
+    const size_t from{max(text.size() * t / threads, starts[t - 1])};
+    const auto [at, n] = find(from);
+    starts[t] = min(at + n, text.size());
+  }
+  const auto chunk = [&](size_t t) {
+    const string_view c{text.substr(starts[t], starts[t + 1] - starts[t])};
+    return slices(c.begin(), c.end(), sep);
+  };
+  const auto on_threads = [&](auto f) {
+    vector<jthread> workers{};
+    for (size_t t{}; t < threads; ++t) workers.emplace_back(f, t);
+  };
+  // first[t] is the index of chunk t's first slice
+  vector<size_t> first(threads + 1);
+  on_threads([&](size_t t) {
+    const auto r = chunk(t);
+    size_t n{};
+    for (auto it = r.begin(); it != r.end(); ++it) ++n;
+    first[t + 1] = n;
+  });
+  partial_sum(first.begin(), first.end(), first.begin());
+  out.resize(first.back());
+  on_threads([&](size_t t) {
+    size_t i{first[t]};
+    for (string_view s : chunk(t)) out[i++] = s;
+  });
+  return out;
+}
+
+template <typename F>
+double time_ms(F &&f) {
+  auto t1 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t1)
+      .count();
+}
+
+// the split() this file started with: every element is pushed into a
+// temporary slice, which is then copied into dest
+template <typename It, typename Oc, typename V>
+It split_copying(It it, It end_it, Oc &dest, const V &sep) {
   typename Oc::value_type slice{};
   while (it != end_it) {
-    if (f(*it, sep)) {
+    if (*it == sep) {
       dest.push_back(slice);
       slice.clear();
     } else {
@@ -16,22 +446,144 @@ It split(It it, It end_it, Oc &dest, const V &sep, Pred &f) {
   }
   if (slice.size()) dest.push_back(slice);
   return it;
-};
+}
 
-constexpr auto eq = [](const auto &el, const auto &sep) { return el == sep; };
+// /etc/passwd-style lines with 7 fields, some longer than the small string
+// buffer
+string make_passwd(size_t lines, unsigned seed) {
+  mt19937 rng{seed};
+  const array<string_view, 4> shells{"/bin/bash", "/usr/sbin/nologin",
+                                     "/bin/sync", "/usr/bin/zsh"};
+  string out{};
+  for (size_t i{}; i < lines; ++i) {
+    const auto uid = rng() % 60000;
+    out += format("user{}:x:{}:{}:User Number {},Room {},,:/home/user{}:{}\n",
+                  i, uid, uid, i, rng() % 1000, i, shells[rng() % 4]);
+  }
+  return out;
+}
 
-template <typename It, typename Oc, typename V>
-It split(It it, const It end_it, Oc &dest, const V &sep) {
-  return split(it, end_it, dest, sep, eq);
+// Splits every line into fields: the original copying split, split() on
+// top of slices, and the slices themselves
+void bench_split(size_t lines) {
+  const string text{make_passwd(lines, 42)};
+  cout << format("\n{} lines, {:.1f} MB:\n", lines, text.size() / 1e6);
+  cout << "method            MB/s  allocations/field\n";
+  const auto run = [&](string_view name, auto per_line) {
+    size_t fields{};
+    const size_t allocs{g_allocations};
+    const double ms = time_ms([&] {
+      for (string_view line : strslices(text, '\n'))
+        fields += per_line(line);
+    });
+    cout << format("{:14} {:7.0f} {:18.3f}\n", name, text.size() / ms / 1e3,
+                   static_cast<double>(g_allocations - allocs) / fields);
+  };
+  run("split (old)", [](string_view line) {
+    vector<string> dest{};
+    split_copying(line.begin(), line.end(), dest, ':');
+    return dest.size();
+  });
+  run("split", [](string_view line) {
+    vector<string> dest{};
+    strsplit(line, dest, ':');
+    return dest.size();
+  });
+  run("slices", [](string_view line) {
+    size_t n{}, bytes{};
+    for (string_view field : strslices(line, ':')) {
+      ++n;
+      bytes += field.size();
+    }
+    return bytes ? n : 0;
+  });
 }
 
-template <typename In, typename Out, typename V>
-Out &strsplit(const In &str, Out &dest, const V &sep) {
-  split(str.begin(), str.end(), dest, sep, eq);
-  return dest;
+// Separator scanning on one large buffer: the generic template with a
+// predicate it cannot see through, the CharScanner fast path, a two-byte
+// separator, and the CharScanner and parallel_split storing every slice
+void bench_scan(size_t bytes) {
+  string text{make_passwd(bytes / 80, 7)};
+  cout << format("\n{:.0f} MB buffer:\n", text.size() / 1e6);
+  cout << "method                     slices     GB/s\n";
+  const auto row = [&](string_view name, size_t n, double ms) {
+    cout << format("{:22} {:10} {:8.2f}\n", name, n, text.size() / ms / 1e6);
+  };
+  const auto count = [](auto &&r) {
+    size_t n{};
+    for (auto it = r.begin(); it != r.end(); ++it) ++n;
+    return n;
+  };
+  size_t n{};
+  double ms = time_ms([&] {
+    n = count(slices(text.begin(), text.end(), ':',
+                     [](char el, char sep) { return el == sep; }));
+  });
+  row("generic, ':'", n, ms);
+  ms = time_ms([&] { n = count(strslices(text, ':')); });
+  row("CharScanner, ':'", n, ms);
+  ms = time_ms([&] { n = count(strslices(text, string_view{":/"})); });
+  row("find_sep, \":/\"", n, ms);
+  vector<string_view> seq{};
+  ms = time_ms([&] {
+    for (string_view s : strslices(text, ':')) seq.push_back(s);
+  });
+  row("CharScanner, stored", seq.size(), ms);
+  for (size_t threads : {1, 2, 4, 8}) {
+    vector<string_view> par{};
+    ms = time_ms([&] { par = parallel_split(text, ':', threads); });
+    row(format("parallel_split x{}{}", threads, par == seq ? "" : " (!)"),
+        par.size(), ms);
+  }
+}
+
+// Splits every record into one output for all records and then reads
+// every field once: vector<string> or vector<vector<int>> against
+// FlatSlices. Reports allocations per field, the split time and the time
+// of the read pass
+template <typename Flat, typename Nested, typename Rec>
+void bench_flat_one(string_view name, const vector<Rec> &records,
+                    typename Rec::value_type sep) {
+  const auto run = [&]<typename Out>(string_view kind) {
+    Out out{};
+    const size_t allocs{g_allocations};
+    const double split_ms = time_ms([&] {
+      for (const auto &r : records) strsplit(r, out, sep);
+    });
+    const size_t fields{out.size()};
+    const double per_field{static_cast<double>(g_allocations - allocs) /
+                           fields};
+    uint64_t h{};
+    const double read_ms = time_ms([&] {
+      for (const auto &f : out)
+        for (const auto &e : f) h = h * 31 + static_cast<uint64_t>(e);
+    });
+    cout << format("{:6} {:16} {:9} {:12.3f} {:9.1f} {:8.1f}  {:x}\n", name,
+                   kind, fields, per_field, split_ms, read_ms, h & 0xFFFF);
+  };
+  run.template operator()<Nested>("nested");
+  run.template operator()<Flat>("FlatSlices");
 }
 
-int main() {
+void bench_flat(size_t records) {
+  cout << format("\n{} records:\n", records);
+  cout << "input  output              fields  allocs/field  split ms  "
+          "read ms  check\n";
+  const string text{make_passwd(records, 11)};
+  vector<string_view> lines{};
+  for (string_view l : strslices(text, '\n')) lines.push_back(l);
+  bench_flat_one<FlatSlices<char>, vector<string>>("passwd", lines, ':');
+
+  mt19937 rng{13};
+  vector<vector<int>> ints(records);
+  for (auto &r : ints) {
+    for (size_t i{}, n{8 + rng() % 8}; i < n; ++i)
+      r.push_back(i % 4 == 3 ? -1 : static_cast<int>(rng() % 1000));
+  }
+  bench_flat_one<FlatSlices<int>, vector<vector<int>>>("ints", ints, -1);
+}
+
+int main(int argc, char *argv[]) {
   constexpr char strsep{':'};
   const string str{"sync:x:4:65534:sync:/bin:/bin/sync"};
   vector<string> dest_vs{};
@@ -44,6 +596,27 @@ int main() {
   for (const auto &e : dest_vs2) cout << format("[{}] ", e);
   cout << '\n';
 
+  // the same fields as views into str
+  for (string_view e : strslices(str, strsep)) cout << format("[{}] ", e);
+  cout << '\n';
+
+  // any forward range works, its slices are subranges
+  const list<char> lc{'a', 'b', ':', 'c'};
+  vector<string> dest_lc{};
+  split(lc.begin(), lc.end(), dest_lc, ':');
+  for (const auto &e : dest_lc) cout << format("[{}] ", e);
+  cout << '\n';
+
+  // a predicate of its own decides per char, here any char of the set
+  const string words{"a b\tc"};
+  const auto any_of = [](char c, string_view set) {
+    return set.find(c) != string_view::npos;
+  };
+  vector<string> dest_ws{};
+  split(words.begin(), words.end(), dest_ws, string_view{" \t"}, any_of);
+  for (const auto &e : dest_ws) cout << format("[{}] ", e);
+  cout << '\n';
+
   constexpr int intsep{-1};
   vector<int> vi{1, 2, 3, 4, intsep, 5, 6, 7, 8, intsep, 9, 10, 11, 12};
   vector<vector<int>> dest_vi{};
@@ -54,4 +627,22 @@ int main() {
     cout << format("[{}] ", s);
   }
   cout << '\n';
+
+  // the same slices in one buffer plus offsets
+  FlatSlices<int> flat_vi{};
+  split(vi.begin(), vi.end(), flat_vi, intsep);
+  for (span<const int> v : flat_vi) {
+    string s;
+    for (const auto &e : v) s += format("{}", e);
+    cout << format("[{}] ", s);
+  }
+  cout << '\n';
+
+  // the benchmarks only run on request, e.g. --bench 1000000 lines, the
+  // scan buffer has 256 bytes per line
+  if (argc < 2 || argv[1] != "--bench"sv) return 0;
+  const size_t lines{argc > 2 ? stoull(argv[2]) : 1'000'000};
+  bench_split(lines);
+  bench_scan(lines * 256);
+  bench_flat(lines);
 }
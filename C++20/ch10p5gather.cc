@@ -1,7 +1,72 @@
 #include <bits/stdc++.h>
 
+#include <execution>
+
 using namespace std;
 
+// counts every allocation, to show that the scratch gather needs none
+atomic_size_t g_allocations{};
+
+constexpr align_val_t malloc_align{alignof(max_align_t)};
+
+// every operator new and delete lands here, so a gather that allocates
+// through any of them shows up in g_allocations
+[[gnu::noinline]] void *counted_alloc(size_t n, align_val_t align) noexcept {
+  const size_t a{static_cast<size_t>(align)};
+  n = max(n, size_t{1});
+  void *p{a <= alignof(max_align_t) ? malloc(n)
+                                     : aligned_alloc(a, (n + a - 1) / a * a)};
+  if (p) ++g_allocations;
+  return p;
+}
+[[gnu::noinline]] void counted_free(void *p) noexcept {
+  free(p);
+}
+
+void *counted_new(size_t n, align_val_t a) {
+  if (void *p = counted_alloc(n, a)) return p;
+  throw bad_alloc{};
+}
+
+void *operator new(size_t n) { return counted_new(n, malloc_align); }
+void *operator new[](size_t n) { return counted_new(n, malloc_align); }
+void *operator new(size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new[](size_t n, align_val_t a) { return counted_new(n, a); }
+void *operator new(size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new[](size_t n, const nothrow_t &) noexcept {
+  return counted_alloc(n, malloc_align);
+}
+void *operator new(size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void *operator new[](size_t n, align_val_t a, const nothrow_t &) noexcept {
+  return counted_alloc(n, a);
+}
+void operator delete(void *p) noexcept { counted_free(p); }
+void operator delete[](void *p) noexcept { counted_free(p); }
+void operator delete(void *p, size_t) noexcept { counted_free(p); }
+void operator delete[](void *p, size_t) noexcept { counted_free(p); }
+void operator delete(void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete[](void *p, align_val_t) noexcept { counted_free(p); }
+void operator delete(void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, size_t, align_val_t) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, const nothrow_t &) noexcept { counted_free(p); }
+void operator delete[](void *p, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete(void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+void operator delete[](void *p, align_val_t, const nothrow_t &) noexcept {
+  counted_free(p);
+}
+
 // Input : first ... pivot - 1  pivot ... last
 // Result: <part_no> <part_yes> <part_yes> <part_no>
 // Output:    it1                   it2
@@ -11,6 +76,144 @@ pair<It, It> gather(It first, It last, It pivot, Pred pred) {
           stable_partition(pivot, last, pred)};
 }
 
+// Contiguous trivially copyable elements and a stateless predicate, like
+// is_even on ints: such a gather can copy elements around as plain bytes
+// and the predicate can be called without branching on its state
+template <typename It, typename Pred>
+concept compactable =
+    contiguous_iterator<It> && is_trivially_copyable_v<iter_value_t<It>> &&
+    is_empty_v<Pred> && is_trivially_copyable_v<Pred> &&
+    predicate<const Pred &, const iter_value_t<It> &>;
+
+// Stable partition of [b, e) that puts the elements with pred == Want
+// first and returns where the others begin. Every element is written both
+// to the compacted front (the write position never passes the read one)
+// and to scratch, and only one of the two positions advances, so the loop
+// has no branch on pred. The others are then copied back from scratch
+template <bool Want, typename T, typename Pred>
+T *compact_partition(T *b, T *e, const Pred &pred, T *scratch) {
+  T *out{b}, *rest{scratch};
+  for (T *p{b}; p != e; ++p) {
+    const T v{*p};
+    const bool keep{static_cast<bool>(pred(v)) == Want};
+    *out = v;
+    *rest = v;
+    out += keep;
+    rest += !keep;
+  }
+  copy(scratch, rest, out);
+  return out;
+}
+
+// gather() through scratch supplied by the caller, which needs room for
+// the longer of the two sides. For compactable element and predicate types
+// it runs compact_partition() and allocates nothing, otherwise and when
+// scratch is too small it is the generic gather()
+template <typename It, typename Pred>
+pair<It, It> gather(It first, It last, It pivot, Pred pred,
+                    span<iter_value_t<It>> scratch) {
+  if constexpr (compactable<It, Pred>) {
+    if (scratch.size() >= static_cast<size_t>(max(pivot - first,
+                                                  last - pivot))) {
+      auto *const f = to_address(first), *const p = to_address(pivot);
+      auto *const l = to_address(last), *const s = scratch.data();
+      return {first + (compact_partition<false>(f, p, pred, s) - f),
+              pivot + (compact_partition<true>(p, l, pred, s) - p)};
+    }
+  }
+  return gather(first, last, pivot, pred);
+}
+
+// runs f(0) ... f(threads - 1), f(0) on the calling thread
+template <typename F>
+void parallel_for(size_t threads, F f) {
+  vector<jthread> workers{};
+  for (size_t t{1}; t < threads; ++t) workers.emplace_back(f, t);
+  f(0);
+}
+
+// Stable partition of [first, last) on up to threads threads, through
+// scratch, which has room for last - first elements. Every thread takes a
+// chunk and counts its matches; the counts give each chunk the place of
+// its matches and non-matches in scratch, every chunk moves its elements
+// there and scratch is moved back. pred is called twice per element
+template <typename It, typename Pred>
+It stable_partition_par(It first, It last, Pred pred,
+                        iter_value_t<It> *scratch, size_t threads) {
+  constexpr size_t min_chunk{1 << 16};
+  const auto n = static_cast<size_t>(last - first);
+  threads = clamp<size_t>(threads, 1, max<size_t>(n / min_chunk, 1));
+  const auto chunk = [&](size_t t) {
+    return pair{first + n * t / threads, first + n * (t + 1) / threads};
+  };
+  // yes[t + 1] matches in chunk t, turned into offsets below
+  vector<size_t> yes(threads + 1);
+  parallel_for(threads, [&](size_t t) {
+    const auto [b, e] = chunk(t);
+    yes[t + 1] = static_cast<size_t>(count_if(b, e, pred));
+  });
+  inclusive_scan(yes.begin(), yes.end(), yes.begin());
+  const size_t total{yes[threads]};
+  parallel_for(threads, [&](size_t t) {
+    const auto [b, e] = chunk(t);
+    auto *y = scratch + yes[t];
+    auto *no = scratch + total + (b - first) - yes[t];
+    // picks the destination instead of branching on pred
+    for (auto it{b}; it != e; ++it) {
+      const bool match{static_cast<bool>(pred(*it))};
+      *(match ? y : no) = move(*it);
+      y += match;
+      no += !match;
+    }
+  });
+  parallel_for(threads, [&](size_t t) {
+    const auto [b, e] = chunk(t);
+    move(scratch + (b - first), scratch + (e - first), b);
+  });
+  return first + total;
+}
+
+// gather on up to threads threads: both sides are partitioned at the same
+// time, each with at least one and together with exactly threads threads,
+// shared by size, and both use their own part of one scratch buffer. One
+// thread is the sequential gather()
+template <typename It, typename Pred>
+pair<It, It> gather_par(It first, It last, It pivot, Pred pred,
+                        size_t threads) {
+  const auto n = static_cast<size_t>(last - first);
+  if (threads <= 1 || !n) return gather(first, last, pivot, pred);
+  // not value initialized, every element is written before it is read
+  const auto scratch = make_unique_for_overwrite<iter_value_t<It>[]>(n);
+  const auto left_n = static_cast<size_t>(pivot - first);
+  const size_t left_threads{
+      clamp<size_t>((threads * left_n + n / 2) / n, 1, threads - 1)};
+  const size_t right_threads{threads - left_threads};
+  It it1{};
+  jthread left{[&] {
+    it1 = stable_partition_par(first, pivot, not_fn(pred), scratch.get(),
+                               left_threads);
+  }};
+  const It it2{stable_partition_par(pivot, last, pred,
+                                    scratch.get() + left_n, right_threads)};
+  left.join();
+  return {it1, it2};
+}
+
+// Same result as gather(first, last, pivot, pred), including the order of
+// the elements on both sides. execution::seq runs gather(), the parallel
+// policies use gather_par() on every hardware thread
+template <typename Policy, typename It, typename Pred>
+  requires is_execution_policy_v<remove_cvref_t<Policy>>
+pair<It, It> gather(Policy &&, It first, It last, It pivot, Pred pred) {
+  if constexpr (is_same_v<remove_cvref_t<Policy>,
+                          execution::sequenced_policy>) {
+    return gather(first, last, pivot, pred);
+  } else {
+    return gather_par(first, last, pivot, pred,
+                      max(thread::hardware_concurrency(), 1u));
+  }
+}
+
 constexpr auto midit = [](auto &v) {
   return v.begin() + (v.end() - v.begin()) / 2;
 };
@@ -24,7 +227,69 @@ constexpr auto is_even_char = [](auto c) {
     return false;
 };
 
-int main() {
+template <typename F>
+double time_ms(F &&f) {
+  auto t1 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t1)
+      .count();
+}
+
+// gather() against gather_par() on n random ints around the middle, every
+// parallel result is compared with the sequential one
+void bench_gather(size_t n) {
+  vector<int> input(n);
+  mt19937 rng{42};
+  ranges::generate(input, [&] { return static_cast<int>(rng() % 1000); });
+  cout << format("\n{} ints, gather is_even around the middle:\n", n);
+  cout << "method          threads        ms  same\n";
+  vector<int> expected{input};
+  const double seq_ms = time_ms([&] {
+    gather(expected.begin(), expected.end(), midit(expected), is_even);
+  });
+  cout << format("{:15} {:7} {:9.1f}\n", "gather", 1, seq_ms);
+  for (size_t threads : {1, 2, 4, 8}) {
+    vector<int> v{input};
+    const double ms = time_ms(
+        [&] { gather_par(v.begin(), v.end(), midit(v), is_even, threads); });
+    cout << format("{:15} {:7} {:9.1f}  {}\n", "gather_par", threads, ms,
+                   v == expected ? "yes" : "NO");
+  }
+}
+
+// gather() against the scratch gather() on n ints and n digit chars, with
+// allocations per call and ns per element
+void bench_scratch(size_t n) {
+  cout << format("\n{} elements, gather around the middle:\n", n);
+  cout << "data   method               allocations      ns/element  same\n";
+  const auto run = [&](string_view data, auto input, auto pred) {
+    auto expected{input};
+    size_t allocs{g_allocations};
+    double ms = time_ms([&] {
+      gather(expected.begin(), expected.end(), midit(expected), pred);
+    });
+    cout << format("{:6} {:20} {:11} {:15.2f}\n", data, "gather",
+                   g_allocations - allocs, ms * 1e6 / n);
+    using T = typename decltype(input)::value_type;
+    vector<T> scratch(n / 2 + 1);
+    allocs = g_allocations;
+    ms = time_ms([&] {
+      gather(input.begin(), input.end(), midit(input), pred, span{scratch});
+    });
+    cout << format("{:6} {:20} {:11} {:15.2f}  {}\n", data,
+                   "gather + scratch", g_allocations - allocs, ms * 1e6 / n,
+                   input == expected ? "yes" : "NO");
+  };
+  mt19937 rng{7};
+  vector<int> ints(n);
+  ranges::generate(ints, [&] { return static_cast<int>(rng() % 1000); });
+  run("int", move(ints), is_even);
+  string digits(n, ' ');
+  ranges::generate(digits, [&] { return "0123456789-"[rng() % 11]; });
+  run("char", move(digits), is_even_char);
+}
+
+int main(int argc, char *argv[]) {
   vector<int> vint{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
   string jenny{"867-5309"};
 
@@ -47,4 +312,29 @@ int main() {
   gather(jenny.begin(), jenny.end(), jenny.end(), is_even_char);
   for (const auto &el : jenny) cout << el;
   cout << '\n';
+
+  vector<int> vpar{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  gather(execution::par, vpar.begin(), vpar.end(), midit(vpar), is_even);
+  for (const auto &el : vpar) cout << el;
+  cout << '\n';
+
+  // ints take the allocation-free path, strings the generic one
+  vector<int> vscratch{0, 1, 2, 3, 4, 5, 6, 7, 8, 9}, buf(5);
+  gather(vscratch.begin(), vscratch.end(), midit(vscratch), is_even,
+         span{buf});
+  for (const auto &el : vscratch) cout << el;
+  cout << '\n';
+  vector<string> words{"one", "two", "three", "four", "five", "six"};
+  vector<string> wbuf(3);
+  gather(words.begin(), words.end(), midit(words),
+         [](const string &w) { return w.size() == 3; }, span{wbuf});
+  for (const auto &w : words) cout << w << ' ';
+  cout << '\n';
+
+  // the benchmarks only run on request, e.g. --bench 100000000 ints, the
+  // scratch comparison uses a tenth of that
+  if (argc < 2 || argv[1] != "--bench"sv) return 0;
+  const size_t n{argc > 2 ? stoull(argv[2]) : 100'000'000};
+  bench_gather(n);
+  bench_scratch(n / 10);
 }
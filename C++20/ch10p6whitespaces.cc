@@ -1,5 +1,9 @@
 #include <bits/stdc++.h>
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 using namespace std;
 
 // POSIX isspace() may not work for all systems, write templated one
@@ -11,7 +15,137 @@ bool isws(const T &c) {
   return false;
 }
 
+// isws() for every byte at once, '\0' included because it ends the
+// whitespace array that isws() loops over
+constexpr auto ws_table = [] {
+  array<bool, 256> t{};
+  for (char c : " \t\r\n\v\f") t[static_cast<unsigned char>(c)] = true;
+  return t;
+}();
+
+// Whitespace bitmask of one block: bit i is set when p[i] is whitespace,
+// i.e. ' ', '\0' or '\t' ... '\r', which are contiguous
+#if defined(__AVX2__)
+constexpr size_t ws_block{32};
+
+inline uint32_t ws_mask(const char *p) {
+  const __m256i v{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))};
+  const __m256i ctrl{_mm256_sub_epi8(v, _mm256_set1_epi8('\t'))};
+  const __m256i ws{_mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                      _mm256_cmpeq_epi8(v, _mm256_setzero_si256())),
+      _mm256_cmpeq_epi8(_mm256_min_epu8(ctrl, _mm256_set1_epi8('\r' - '\t')),
+                        ctrl))};
+  return static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+}
+#elif defined(__SSE2__)
+constexpr size_t ws_block{16};
+
+inline uint32_t ws_mask(const char *p) {
+  const __m128i v{_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))};
+  const __m128i ctrl{_mm_sub_epi8(v, _mm_set1_epi8('\t'))};
+  const __m128i ws{_mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                   _mm_cmpeq_epi8(v, _mm_setzero_si128())),
+      _mm_cmpeq_epi8(_mm_min_epu8(ctrl, _mm_set1_epi8('\r' - '\t')), ctrl))};
+  return static_cast<uint32_t>(_mm_movemask_epi8(ws));
+}
+#else
+constexpr size_t ws_block{16};
+
+inline uint32_t ws_mask(const char *p) {
+  uint32_t bits{};
+  for (size_t i{}; i < ws_block; ++i)
+    bits |= uint32_t{ws_table[static_cast<unsigned char>(p[i])]} << i;
+  return bits;
+}
+#endif
+
+// Writes the bytes of the 8 at p whose drop bit is clear to out, in order,
+// and returns the end of what it kept. With SSSE3 one shuffle from a table
+// of all 256 drop masks does it. All 8 bytes are stored, but out is never
+// ahead of p, so even in place no unread byte is overwritten
+#if defined(__SSSE3__)
+constexpr auto ws_shuffles = [] {
+  array<array<uint8_t, 8>, 256> t{};
+  for (size_t m{}; m < 256; ++m) {
+    size_t k{};
+    for (uint8_t j{}; j < 8; ++j)
+      if (!(m >> j & 1)) t[m][k++] = j;
+    for (; k < 8; ++k) t[m][k] = 0x80;  // zero
+  }
+  return t;
+}();
+
+inline char *compact8(const char *p, uint32_t drop, char *out) {
+  const __m128i v{_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))};
+  const __m128i shuffle{_mm_loadl_epi64(
+      reinterpret_cast<const __m128i *>(ws_shuffles[drop].data()))};
+  _mm_storel_epi64(reinterpret_cast<__m128i *>(out),
+                   _mm_shuffle_epi8(v, shuffle));
+  return out + 8 - popcount(drop);
+}
+#else
+inline char *compact8(const char *p, uint32_t drop, char *out) {
+  for (size_t j{}; j < 8; ++j) {
+    *out = p[j];
+    out += !(drop >> j & 1);
+  }
+  return out;
+}
+#endif
+
+// Collapses every run of whitespace in [in, in + n) to its first character,
+// like delws(), writes the result to out and returns its length. out may
+// be in itself, it never gets ahead of the input. A block without two
+// adjacent whitespace characters is copied as a whole, any other block is
+// compacted 8 bytes at a time
+inline size_t collapse_ws(const char *in, size_t n, char *out) {
+  char *const out_begin{out};
+  uint32_t prev{};  // 1 when the byte before the block was whitespace
+  size_t i{};
+  for (; i + ws_block <= n; i += ws_block) {
+    const uint32_t ws{ws_mask(in + i)};
+    const uint32_t drop{ws & (ws << 1 | prev)};
+    if (!drop) {
+      memmove(out, in + i, ws_block);
+      out += ws_block;
+    } else {
+      for (size_t j{}; j < ws_block; j += 8)
+        out = compact8(in + i + j, drop >> j & 0xFF, out);
+    }
+    prev = ws >> (ws_block - 1) & 1;
+  }
+  for (bool was_ws{prev != 0}; i < n; ++i) {
+    const bool is_ws{ws_table[static_cast<unsigned char>(in[i])]};
+    *out = in[i];
+    out += !(is_ws && was_ws);
+    was_ws = is_ws;
+  }
+  return static_cast<size_t>(out - out_begin);
+}
+
+// in place, s only shrinks so it is never reallocated
+void delws_inplace(string &s) {
+  s.resize(collapse_ws(s.data(), s.size(), s.data()));
+}
+
 string delws(const string &s) {
+  string outstr{s};
+  delws_inplace(outstr);
+  return outstr;
+}
+
+template <typename F>
+double time_ms(F &&f) {
+  auto t1 = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - t1)
+      .count();
+}
+
+// the delws() this file started with
+string delws_unique(const string &s) {
   string outstr{s};
   // std::unique() removes adjacent duplicates
   auto its =
@@ -22,9 +156,56 @@ string delws(const string &s) {
   return outstr;
 }
 
-int main() {
+// log lines padded with runs of spaces and tabs
+string make_log(size_t bytes, unsigned seed) {
+  mt19937 rng{seed};
+  const array<string_view, 4> levels{"INFO ", "WARN ", "DEBUG", "ERROR"};
+  string out{};
+  while (out.size() < bytes) {
+    out += format("2026-10-17 12:{:02}:{:02}.{:03}  {}{}worker-{}\t\tjob {} "
+                  "done in {:>6} ms{}\n",
+                  rng() % 60, rng() % 60, rng() % 1000, levels[rng() % 4],
+                  string(1 + rng() % 4, ' '), rng() % 16, rng() % 100000,
+                  rng() % 10000, rng() % 4 ? "" : "   \t ");
+  }
+  return out;
+}
+
+// the original delws() against collapse_ws() on a large log, with memcpy
+// of the same bytes as the ceiling
+void bench_delws(size_t bytes) {
+  const string log{make_log(bytes, 3)};
+  cout << format("\n{:.0f} MB of log lines:\n", log.size() / 1e6);
+  cout << "method                 MB/s  same\n";
+  const string expected{delws_unique(log)};
+  // only the kernel is timed, its output is checked afterwards
+  const auto run = [&](string_view name, auto kernel, const string &out) {
+    const double ms = time_ms(kernel);
+    cout << format("{:20} {:7.0f}  {}\n", name, log.size() / ms / 1e3,
+                   out == expected ? "yes" : "NO");
+  };
+  string unique_out{}, out{};
+  run("delws (unique)", [&] { unique_out = delws_unique(log); }, unique_out);
+  run("delws", [&] { out = delws(log); }, out);
+  string buf(log.size(), '\0');
+  run("collapse_ws (buffer)",
+      [&] { buf.resize(collapse_ws(log.data(), log.size(), buf.data())); },
+      buf);
+  string copy{log};
+  run("delws_inplace", [&] { delws_inplace(copy); }, copy);
+  string dst(log.size(), '\0');
+  const double ms =
+      time_ms([&] { memcpy(dst.data(), log.data(), log.size()); });
+  cout << format("{:20} {:7.0f}\n", "memcpy", log.size() / ms / 1e3);
+}
+
+int main(int argc, char *argv[]) {
   const string s{"big     bad    \t   wolf"};
   const string s2{delws(s)};
   cout << format("[{}]\n", s);
   cout << format("[{}]\n", s2);
+
+  // the benchmark only runs on request, e.g. --bench 100000000 bytes
+  if (argc < 2 || argv[1] != "--bench"sv) return 0;
+  bench_delws(argc > 2 ? stoull(argv[2]) : 100'000'000);
 }